@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef API_VIDEO_ENCODED_VIDEO_SOURCE_H_
+#define API_VIDEO_ENCODED_VIDEO_SOURCE_H_
+
+#include "api/units/data_rate.h"
+#include "api/video/encoded_image.h"
+#include "rtc_base/ref_count.h"
+
+namespace webrtc {
+
+struct CodecSpecificInfo;
+
+// Receives already encoded frames from an EncodedVideoSourceInterface, e.g.
+// an application transport packetizing them for one receiver.
+class EncodedVideoSinkInterface {
+ public:
+  virtual ~EncodedVideoSinkInterface() = default;
+
+  // |codec_specific_info| carries what the RTP payload descriptors need,
+  // e.g. temporal and spatial layer indices and, for generic descriptors,
+  // frame dependencies. The encoded data of |encoded_image| is not copied,
+  // so the same EncodedImageBufferInterface may be delivered to any number of
+  // sinks.
+  virtual void OnEncodedFrame(const EncodedImage& encoded_image,
+                              const CodecSpecificInfo* codec_specific_info) = 0;
+};
+
+// Source of already encoded video frames, for instance a forwarder relaying
+// the frames received on one connection to many others without decoding and
+// re-encoding them. RtpSender cannot take an encoded source, so the sinks are
+// provided by the application.
+//
+// The source is called on a single sequence. It must be able to deliver a
+// key frame on request; it typically asks the original sender for one.
+// CachingEncodedVideoSource implements this for forwarders, serving new
+// receivers from a cache rather than from a new key frame.
+class EncodedVideoSourceInterface : public rtc::RefCountInterface {
+ public:
+  virtual void AddSink(EncodedVideoSinkInterface* sink) = 0;
+  virtual void RemoveSink(EncodedVideoSinkInterface* sink) = 0;
+
+  // Called when a receiver behind |sink| requested a key frame, through PLI
+  // or FIR, or when a new sink needs one to start decoding.
+  virtual void OnKeyFrameRequested(EncodedVideoSinkInterface* sink) = 0;
+
+  // Called with the bitrate available to |sink|, so that the source can
+  // select a layer or quality that fits. Sources that cannot adapt may
+  // ignore it.
+  virtual void OnTargetBitrateChanged(EncodedVideoSinkInterface* sink,
+                                      DataRate target_bitrate) {}
+
+ protected:
+  ~EncodedVideoSourceInterface() override = default;
+};
+
+}  // namespace webrtc
+
+#endif  // API_VIDEO_ENCODED_VIDEO_SOURCE_H_
@@ -80,6 +80,23 @@ class RTC_EXPORT NV12Buffer : public NV12BufferInterface {
   const std::unique_ptr<uint8_t, AlignedFreeDeleter> data_;
 };
 
+// Crops and scales |src| into a new NV12Buffer. VideoFrameBuffer's
+// CropAndScale() converts NV12 buffers to I420; ScaledBufferPyramid and
+// application code that consumes NV12 use this to avoid the conversion.
+inline rtc::scoped_refptr<NV12Buffer> CropAndScaleNV12(
+    const NV12BufferInterface& src,
+    int offset_x,
+    int offset_y,
+    int crop_width,
+    int crop_height,
+    int scaled_width,
+    int scaled_height) {
+  rtc::scoped_refptr<NV12Buffer> result =
+      NV12Buffer::Create(scaled_width, scaled_height);
+  result->CropAndScaleFrom(src, offset_x, offset_y, crop_width, crop_height);
+  return result;
+}
+
 }  // namespace webrtc
 
 #endif  // API_VIDEO_NV12_BUFFER_H_
@@ -0,0 +1,177 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef CALL_INCREMENTAL_BITRATE_ALLOCATION_H_
+#define CALL_INCREMENTAL_BITRATE_ALLOCATION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#include "api/units/data_rate.h"
+#include "api/units/time_delta.h"
+#include "api/units/timestamp.h"
+#include "call/bitrate_allocator.h"
+
+namespace webrtc {
+namespace bitrate_allocator_impl {
+
+// Water-filling allocation of |bitrate| over |tracks|: every track gets its
+// min bitrate, and the remainder is shared in proportion to bitrate_priority,
+// with tracks that reach |max_multiplier| times their max bitrate saturating
+// and handing their share to the others. Instead of redistributing in rounds
+// until no track saturates, the tracks are sorted once by the water level at
+// which they saturate, giving O(n log n) for n tracks.
+//
+// Tracks that cannot get their min bitrate are expected to be removed by the
+// caller before; if |bitrate| does not cover all min bitrates, every track
+// gets its min bitrate. Tracks with a non-positive bitrate_priority get their
+// min bitrate only, and bitrate left once every track is saturated is not
+// allocated. Returns the allocation of each track, in the order of |tracks|.
+inline std::vector<uint32_t> WaterFillAllocation(
+    const std::vector<AllocatableTrack>& tracks,
+    uint32_t bitrate,
+    uint32_t max_multiplier) {
+  std::vector<uint32_t> allocation(tracks.size());
+  uint64_t sum_min_bitrates = 0;
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    allocation[i] = tracks[i].config.min_bitrate_bps;
+    sum_min_bitrates += tracks[i].config.min_bitrate_bps;
+  }
+  if (bitrate <= sum_min_bitrates)
+    return allocation;
+
+  // Water level at which each track saturates, i.e. the bitrate above its
+  // min per unit of priority. A max bitrate of 0 means no max.
+  std::vector<double> saturation_level(tracks.size());
+  std::vector<size_t> order;
+  order.reserve(tracks.size());
+  double total_priority = 0;
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    const MediaStreamAllocationConfig& config = tracks[i].config;
+    if (config.bitrate_priority <= 0)
+      continue;
+    if (config.max_bitrate_bps == 0) {
+      saturation_level[i] = std::numeric_limits<double>::infinity();
+    } else {
+      const double cap =
+          std::max<double>(config.min_bitrate_bps,
+                           static_cast<double>(config.max_bitrate_bps) *
+                               max_multiplier);
+      saturation_level[i] =
+          (cap - config.min_bitrate_bps) / config.bitrate_priority;
+    }
+    order.push_back(i);
+    total_priority += config.bitrate_priority;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return saturation_level[a] < saturation_level[b];
+  });
+
+  double remaining = static_cast<double>(bitrate - sum_min_bitrates);
+  size_t num_saturated = 0;
+  for (; num_saturated < order.size(); ++num_saturated) {
+    const size_t i = order[num_saturated];
+    // The level if all unsaturated tracks shared the remainder; the track
+    // saturates if it fills up below that.
+    if (saturation_level[i] > remaining / total_priority)
+      break;
+    const double headroom =
+        saturation_level[i] * tracks[i].config.bitrate_priority;
+    allocation[i] += static_cast<uint32_t>(headroom);
+    remaining -= headroom;
+    total_priority -= tracks[i].config.bitrate_priority;
+  }
+  if (num_saturated == order.size())
+    return allocation;
+  const double level = remaining / total_priority;
+  for (size_t k = num_saturated; k < order.size(); ++k) {
+    const size_t i = order[k];
+    allocation[i] +=
+        static_cast<uint32_t>(level * tracks[i].config.bitrate_priority);
+  }
+  return allocation;
+}
+
+}  // namespace bitrate_allocator_impl
+
+// Decides which observers to notify of a new allocation, so that small
+// estimate changes do not call OnBitrateUpdated() on every observer.
+//
+// Decreases are always delivered: an observer kept at a stale, higher
+// allocation would overshoot the estimate until its next update. Increases
+// are held back unless they exceed both |Config::increase_hysteresis| of the
+// last notified bitrate and |Config::min_increase|; an observer missing a
+// small increase only leaves some bandwidth unused. Resuming from a zero
+// allocation is always delivered, and every observer is refreshed at least
+// every |Config::max_notification_interval|, since observers also use the
+// loss and RTT of the update for their protection decisions.
+//
+// Not thread safe; used on the sequence of the allocation.
+class BitrateUpdateFilter {
+ public:
+  struct Config {
+    double increase_hysteresis = 0.1;
+    DataRate min_increase = DataRate::KilobitsPerSec(10);
+    TimeDelta max_notification_interval = TimeDelta::Seconds(1);
+  };
+
+  BitrateUpdateFilter() : BitrateUpdateFilter(Config()) {}
+  explicit BitrateUpdateFilter(const Config& config) : config_(config) {}
+
+  // Returns true if |observer| should be notified of |bitrate_bps|, in which
+  // case the notification is recorded as done at |now|.
+  bool ShouldNotify(const BitrateAllocatorObserver* observer,
+                    uint32_t bitrate_bps,
+                    Timestamp now) {
+    auto it = last_notified_.find(observer);
+    if (it == last_notified_.end()) {
+      last_notified_.emplace(observer, Notification{bitrate_bps, now});
+      return true;
+    }
+    Notification& last = it->second;
+    const bool notify =
+        bitrate_bps < last.bitrate_bps || last.bitrate_bps == 0 ||
+        now - last.time >= config_.max_notification_interval ||
+        IsSignificantIncrease(last.bitrate_bps, bitrate_bps);
+    if (notify)
+      last = Notification{bitrate_bps, now};
+    return notify;
+  }
+
+  void RemoveObserver(const BitrateAllocatorObserver* observer) {
+    last_notified_.erase(observer);
+  }
+
+ private:
+  struct Notification {
+    uint32_t bitrate_bps;
+    Timestamp time;
+  };
+
+  bool IsSignificantIncrease(uint32_t last_bitrate_bps,
+                             uint32_t bitrate_bps) const {
+    const double increase = static_cast<double>(bitrate_bps) - last_bitrate_bps;
+    return increase > last_bitrate_bps * config_.increase_hysteresis &&
+           increase > config_.min_increase.bps();
+  }
+
+  const Config config_;
+  std::map<const BitrateAllocatorObserver*, Notification> last_notified_;
+};
+
+}  // namespace webrtc
+
+#endif  // CALL_INCREMENTAL_BITRATE_ALLOCATION_H_
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef COMMON_VIDEO_H264_H264_START_CODE_SCANNER_H_
+#define COMMON_VIDEO_H264_H264_START_CODE_SCANNER_H_
+
+// Defines WEBRTC_ARCH_X86_FAMILY, used below.
+#include "rtc_base/system/arch.h"
+
+#if defined(WEBRTC_HAS_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <immintrin.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "common_video/h264/h264_common.h"
+#include "rtc_base/system/avx2_target.h"
+#include "system_wrappers/include/simd_optimization.h"
+
+namespace webrtc {
+namespace H264 {
+
+// Low level start code scanners.
+//
+// Each function returns the offset of the first byte of the first {0 0 1}
+// sequence in |buffer|, or |buffer_size| if there is none. The C version
+// skips three bytes whenever the third byte of a candidate cannot be part of
+// a start code. The SIMD variants compare 16 (SSE2, NEON) or 32 (AVX2)
+// candidate positions at a time.
+
+inline size_t FindStartCode_C(const uint8_t* buffer, size_t buffer_size) {
+  size_t i = 0;
+  while (i + 2 < buffer_size) {
+    if (buffer[i + 2] > 1) {
+      i += 3;
+    } else if (buffer[i + 2] == 1) {
+      if (buffer[i + 1] == 0 && buffer[i] == 0)
+        return i;
+      i += 3;
+    } else {
+      ++i;
+    }
+  }
+  return buffer_size;
+}
+
+#if defined(WEBRTC_HAS_NEON)
+inline size_t FindStartCode_Neon(const uint8_t* buffer, size_t buffer_size) {
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t one = vdupq_n_u8(1);
+  size_t i = 0;
+  for (; i + 18 <= buffer_size; i += 16) {
+    const uint8x16_t match = vandq_u8(
+        vandq_u8(vceqq_u8(vld1q_u8(buffer + i), zero),
+                 vceqq_u8(vld1q_u8(buffer + i + 1), zero)),
+        vceqq_u8(vld1q_u8(buffer + i + 2), one));
+    const uint64x2_t match64 = vreinterpretq_u64_u8(match);
+    if ((vgetq_lane_u64(match64, 0) | vgetq_lane_u64(match64, 1)) != 0) {
+      for (size_t k = i;; ++k) {
+        if (buffer[k] == 0 && buffer[k + 1] == 0 && buffer[k + 2] == 1)
+          return k;
+      }
+    }
+  }
+  return i + FindStartCode_C(buffer + i, buffer_size - i);
+}
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+inline size_t FindStartCode_Sse2(const uint8_t* buffer, size_t buffer_size) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 18 <= buffer_size; i += 16) {
+    const __m128i b0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + i));
+    const __m128i b1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + i + 1));
+    const __m128i b2 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + i + 2));
+    const int mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero),
+                                    _mm_cmpeq_epi8(b1, zero)),
+                      _mm_cmpeq_epi8(b2, one)));
+    if (mask != 0) {
+      size_t k = i;
+      for (int m = mask; (m & 1) == 0; m >>= 1)
+        ++k;
+      return k;
+    }
+  }
+  return i + FindStartCode_C(buffer + i, buffer_size - i);
+}
+#endif
+
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+WEBRTC_AVX2_TARGET inline size_t FindStartCode_Avx2(const uint8_t* buffer,
+                                                    size_t buffer_size) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 34 <= buffer_size; i += 32) {
+    const __m256i b0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + i));
+    const __m256i b1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + i + 1));
+    const __m256i b2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buffer + i + 2));
+    const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+                                          _mm256_cmpeq_epi8(b1, zero)),
+                         _mm256_cmpeq_epi8(b2, one))));
+    if (mask != 0) {
+      size_t k = i;
+      for (uint32_t m = mask; (m & 1) == 0; m >>= 1)
+        ++k;
+      return k;
+    }
+  }
+  return i + FindStartCode_Sse2(buffer + i, buffer_size - i);
+}
+#endif
+
+// Runs the kernel for |optimization|, usually DetectSimdOptimization().
+inline size_t FindStartCode(SimdOptimization optimization,
+                            const uint8_t* buffer,
+                            size_t buffer_size) {
+  switch (optimization) {
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+    case SimdOptimization::kAvx2:
+      return FindStartCode_Avx2(buffer, buffer_size);
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    case SimdOptimization::kSse2:
+      return FindStartCode_Sse2(buffer, buffer_size);
+#endif
+#if defined(WEBRTC_HAS_NEON)
+    case SimdOptimization::kNeon:
+      return FindStartCode_Neon(buffer, buffer_size);
+#endif
+    default:
+      return FindStartCode_C(buffer, buffer_size);
+  }
+}
+
+// Returns the same NALU indices as FindNaluIndices(), locating the start
+// sequences with FindStartCode().
+inline std::vector<NaluIndex> ScanNaluIndices(const uint8_t* buffer,
+                                              size_t buffer_size) {
+  std::vector<NaluIndex> sequences;
+  if (buffer_size < kNaluShortStartSequenceSize)
+    return sequences;
+  // Like FindNaluIndices(), ignore a start sequence ending on the last byte,
+  // which would start an empty NAL unit.
+  const size_t scan_size = buffer_size - 1;
+  const SimdOptimization optimization = DetectSimdOptimization();
+  size_t i = 0;
+  while (i < scan_size) {
+    const size_t found =
+        i + FindStartCode(optimization, buffer + i, scan_size - i);
+    if (found == scan_size)
+      break;
+    // Check if the start sequence was a 3 or 4 byte one.
+    NaluIndex index = {found, found + kNaluShortStartSequenceSize, 0};
+    if (index.start_offset > 0 && buffer[index.start_offset - 1] == 0)
+      --index.start_offset;
+    if (!sequences.empty()) {
+      sequences.back().payload_size =
+          index.start_offset - sequences.back().payload_start_offset;
+    }
+    sequences.push_back(index);
+    i = found + kNaluShortStartSequenceSize;
+  }
+  if (!sequences.empty()) {
+    sequences.back().payload_size =
+        buffer_size - sequences.back().payload_start_offset;
+  }
+  return sequences;
+}
+
+}  // namespace H264
+}  // namespace webrtc
+
+#endif  // COMMON_VIDEO_H264_H264_START_CODE_SCANNER_H_
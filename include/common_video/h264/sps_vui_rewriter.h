@@ -15,13 +15,22 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "absl/types/optional.h"
+#include "api/array_view.h"
 #include "api/video/color_space.h"
+#include "common_video/h264/h264_common.h"
+#include "common_video/h264/h264_start_code_scanner.h"
 #include "common_video/h264/sps_parser.h"
 #include "rtc_base/buffer.h"
 
 namespace webrtc {
 
+class SpsVuiRewriteCache;
+
 // A class that can parse an SPS+VUI and if necessary creates a copy with
 // updated parameters.
 // The rewriter disables frame buffering. This should force decoders to deliver
@@ -56,6 +65,14 @@ class SpsVuiRewriter : private SpsParser {
       rtc::ArrayView<const uint8_t> buffer,
       const ColorSpace* color_space);
 
+  // Same as above, but looks up SPS blocks in |cache| before parsing them and
+  // stores the result of parsing new ones. SPS served from |cache| are not
+  // counted in the rewrite UMA stats. |cache| may be null.
+  static rtc::Buffer ParseOutgoingBitstreamAndRewrite(
+      rtc::ArrayView<const uint8_t> buffer,
+      const ColorSpace* color_space,
+      SpsVuiRewriteCache* cache);
+
  private:
   static ParseResult ParseAndRewriteSps(
       const uint8_t* buffer,
@@ -67,6 +84,124 @@ class SpsVuiRewriter : private SpsParser {
   static void UpdateStats(ParseResult result, Direction direction);
 };
 
+// Remembers the result of rewriting the most recently seen SPS blocks.
+// Entries are keyed on the bytes of the SPS NAL unit following its one byte
+// NAL unit header, as they appear in the bitstream, i.e. before RBSP decoding
+// and so including emulation prevention bytes, together with the color space
+// the SPS was rewritten with. Encoders emit the same SPS with every keyframe,
+// so with a cache each distinct SPS is parsed and rewritten once instead of
+// once per keyframe.
+// Not thread safe.
+class SpsVuiRewriteCache {
+ public:
+  struct Entry {
+    rtc::Buffer sps_payload;
+    absl::optional<ColorSpace> color_space;
+    SpsVuiRewriter::ParseResult result = SpsVuiRewriter::ParseResult::kFailure;
+    // Rewritten SPS, without the NAL unit header, only populated if |result|
+    // is kVuiRewritten. The header is not part of the key, so the one of the
+    // SPS being rewritten is written in front of it.
+    rtc::Buffer rewritten_sps_payload;
+  };
+
+  // Returns the cached entry matching |sps_payload| and |color_space|, or
+  // null.
+  const Entry* Find(rtc::ArrayView<const uint8_t> sps_payload,
+                    const ColorSpace* color_space) {
+    for (const Entry& entry : entries_) {
+      if (entry.sps_payload.size() == sps_payload.size() &&
+          std::equal(sps_payload.begin(), sps_payload.end(),
+                     entry.sps_payload.begin()) &&
+          entry.color_space.has_value() == (color_space != nullptr) &&
+          (color_space == nullptr || *entry.color_space == *color_space)) {
+        ++hits_;
+        return &entry;
+      }
+    }
+    ++misses_;
+    return nullptr;
+  }
+
+  // Stores |entry|, replacing the oldest entry if the cache is full.
+  const Entry& Insert(Entry entry) {
+    if (entries_.size() < kMaxEntries) {
+      entries_.push_back(std::move(entry));
+      return entries_.back();
+    }
+    Entry& slot = entries_[next_entry_];
+    slot = std::move(entry);
+    next_entry_ = (next_entry_ + 1) % kMaxEntries;
+    return slot;
+  }
+
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+
+ private:
+  // Simulcast streams each carry their own SPS, so keep a few of them.
+  static constexpr size_t kMaxEntries = 4;
+
+  std::vector<Entry> entries_;
+  size_t next_entry_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+inline rtc::Buffer SpsVuiRewriter::ParseOutgoingBitstreamAndRewrite(
+    rtc::ArrayView<const uint8_t> buffer,
+    const ColorSpace* color_space,
+    SpsVuiRewriteCache* cache) {
+  if (!cache)
+    return ParseOutgoingBitstreamAndRewrite(buffer, color_space);
+  // Same as the room reserved by the uncached version for adding a VUI.
+  constexpr size_t kMaxVuiSpsIncrease = 64;
+  std::vector<H264::NaluIndex> nalus =
+      H264::ScanNaluIndices(buffer.data(), buffer.size());
+  rtc::Buffer output_buffer(/*size=*/0, /*capacity=*/buffer.size() +
+                                            nalus.size() * kMaxVuiSpsIncrease);
+  for (const H264::NaluIndex& nalu : nalus) {
+    const uint8_t* start_code_ptr = buffer.data() + nalu.start_offset;
+    const size_t start_code_length =
+        nalu.payload_start_offset - nalu.start_offset;
+    const uint8_t* nalu_ptr = buffer.data() + nalu.payload_start_offset;
+    const size_t nalu_length = nalu.payload_size;
+    if (nalu_length == 0)
+      continue;
+
+    const H264::NaluType nalu_type = H264::ParseNaluType(nalu_ptr[0]);
+    if (nalu_type == H264::NaluType::kAud)
+      continue;
+    if (nalu_type == H264::NaluType::kSps) {
+      rtc::ArrayView<const uint8_t> sps_payload(
+          nalu_ptr + H264::kNaluTypeSize, nalu_length - H264::kNaluTypeSize);
+      const SpsVuiRewriteCache::Entry* entry =
+          cache->Find(sps_payload, color_space);
+      if (!entry) {
+        SpsVuiRewriteCache::Entry new_entry;
+        new_entry.sps_payload.SetData(sps_payload.data(), sps_payload.size());
+        if (color_space)
+          new_entry.color_space = *color_space;
+        absl::optional<SpsParser::SpsState> sps;
+        new_entry.result = ParseAndRewriteSps(
+            sps_payload.data(), sps_payload.size(), &sps, color_space,
+            &new_entry.rewritten_sps_payload, Direction::kOutgoing);
+        if (new_entry.result != ParseResult::kVuiRewritten)
+          new_entry.rewritten_sps_payload.Clear();
+        entry = &cache->Insert(std::move(new_entry));
+      }
+      if (entry->result == ParseResult::kVuiRewritten) {
+        output_buffer.AppendData(start_code_ptr, start_code_length);
+        output_buffer.AppendData(nalu_ptr[0]);
+        output_buffer.AppendData(entry->rewritten_sps_payload);
+        continue;
+      }
+    }
+    output_buffer.AppendData(start_code_ptr, start_code_length);
+    output_buffer.AppendData(nalu_ptr, nalu_length);
+  }
+  return output_buffer;
+}
+
 }  // namespace webrtc
 
 #endif  // COMMON_VIDEO_H264_SPS_VUI_REWRITER_H_
@@ -0,0 +1,169 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef COMMON_VIDEO_INCLUDE_INCREMENTAL_I420_CONVERTER_H_
+#define COMMON_VIDEO_INCLUDE_INCREMENTAL_I420_CONVERTER_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "api/array_view.h"
+#include "api/scoped_refptr.h"
+#include "api/video/i420_buffer.h"
+#include "api/video/video_frame.h"
+#include "rtc_base/ref_counted_object.h"
+#include "third_party/libyuv/include/libyuv/convert.h"
+
+namespace webrtc {
+
+// Converts ARGB screen content to I420, converting only the regions that
+// changed since the previous frame.
+//
+// Screen capturers such as DesktopCapturerDifferWrapper report the updated
+// region of each frame, which for typing or cursor movement is a tiny part of
+// the screen. The converter keeps the I420 result of the previous frame and
+// only runs libyuv's ARGBToI420 on the changed rectangles, expanded to even
+// coordinates so that chroma samples are not shared with unconverted pixels.
+//
+// The returned update rect describes the change relative to the previous
+// Convert() result, and is meant to be set on the VideoFrame. It is not a
+// valid active map for an encoder that predicts from an older frame, e.g.
+// with temporal layers, or after frames were dropped; such consumers must
+// accumulate the update rects of all frames since their reference.
+//
+// The returned buffer may still be referenced by the encoder when the next
+// frame arrives. In that case the previous result is copied into another
+// buffer before the changed regions are converted into it, so buffers handed
+// out are never modified. Two buffers are alternated, so that steady state
+// conversion does not allocate.
+//
+// Not thread safe.
+class IncrementalI420Converter {
+ public:
+  struct Result {
+    rtc::scoped_refptr<I420BufferInterface> buffer;
+    // Bounding box of the converted area; the whole frame if the size
+    // changed or after Reset(), empty if nothing changed.
+    VideoFrame::UpdateRect update_rect;
+  };
+
+  IncrementalI420Converter() = default;
+  IncrementalI420Converter(const IncrementalI420Converter&) = delete;
+  IncrementalI420Converter& operator=(const IncrementalI420Converter&) = delete;
+
+  // |argb| is a |width|x|height| image with |stride| bytes per row, in
+  // libyuv's ARGB byte order (BGRA in memory), as produced by
+  // DesktopFrame. |changed_rects| are the regions that differ from the
+  // previous call; they are ignored, and the full frame converted, on the
+  // first call and whenever the size changes.
+  Result Convert(const uint8_t* argb,
+                 int stride,
+                 int width,
+                 int height,
+                 rtc::ArrayView<const VideoFrame::UpdateRect> changed_rects) {
+    Result result;
+    if (!last_buffer_ || last_buffer_->width() != width ||
+        last_buffer_->height() != height) {
+      last_buffer_ = new Buffer(width, height);
+      spare_buffer_ = nullptr;
+      const VideoFrame::UpdateRect full = {0, 0, width, height};
+      ConvertRect(argb, stride, full, last_buffer_.get());
+      result.buffer = last_buffer_;
+      result.update_rect = full;
+      return result;
+    }
+
+    result.update_rect = {0, 0, 0, 0};
+    bool convert_all = false;
+    if (!last_buffer_->HasOneRef()) {
+      // The previous result is still in use; continue from a copy of it. If
+      // most of the frame changed, converting all of it is cheaper than
+      // copying and converting the changes.
+      if (!spare_buffer_ || !spare_buffer_->HasOneRef())
+        spare_buffer_ = new Buffer(width, height);
+      int64_t changed_area = 0;
+      for (const VideoFrame::UpdateRect& changed : changed_rects)
+        changed_area += static_cast<int64_t>(changed.width) * changed.height;
+      convert_all = 2 * changed_area >= static_cast<int64_t>(width) * height;
+      if (convert_all) {
+        const VideoFrame::UpdateRect full = {0, 0, width, height};
+        ConvertRect(argb, stride, full, spare_buffer_.get());
+      } else {
+        libyuv::I420Copy(
+            last_buffer_->DataY(), last_buffer_->StrideY(),
+            last_buffer_->DataU(), last_buffer_->StrideU(),
+            last_buffer_->DataV(), last_buffer_->StrideV(),
+            spare_buffer_->MutableDataY(), spare_buffer_->StrideY(),
+            spare_buffer_->MutableDataU(), spare_buffer_->StrideU(),
+            spare_buffer_->MutableDataV(), spare_buffer_->StrideV(), width,
+            height);
+      }
+      std::swap(last_buffer_, spare_buffer_);
+    }
+    for (const VideoFrame::UpdateRect& changed : changed_rects) {
+      // Expand to even coordinates, and clip to the frame. The last column or
+      // row of an odd sized frame is included as is.
+      const int left = std::max(changed.offset_x, 0) & ~1;
+      const int top = std::max(changed.offset_y, 0) & ~1;
+      const int right =
+          std::min((changed.offset_x + changed.width + 1) & ~1, width);
+      const int bottom =
+          std::min((changed.offset_y + changed.height + 1) & ~1, height);
+      if (changed.width <= 0 || changed.height <= 0 || left >= right ||
+          top >= bottom) {
+        continue;
+      }
+      const VideoFrame::UpdateRect rect = {left, top, right - left,
+                                           bottom - top};
+      if (!convert_all)
+        ConvertRect(argb, stride, rect, last_buffer_.get());
+      result.update_rect.Union(rect);
+    }
+    result.buffer = last_buffer_;
+    return result;
+  }
+
+  // Makes the next Convert() convert the full frame.
+  void Reset() {
+    last_buffer_ = nullptr;
+    spare_buffer_ = nullptr;
+  }
+
+ private:
+  using Buffer = rtc::RefCountedObject<I420Buffer>;
+
+  // Converts |rect|, which has even offsets, of |argb| into |buffer|.
+  static void ConvertRect(const uint8_t* argb,
+                          int stride,
+                          const VideoFrame::UpdateRect& rect,
+                          I420Buffer* buffer) {
+    libyuv::ARGBToI420(
+        argb + rect.offset_y * stride + rect.offset_x * 4, stride,
+        buffer->MutableDataY() + rect.offset_y * buffer->StrideY() +
+            rect.offset_x,
+        buffer->StrideY(),
+        buffer->MutableDataU() + rect.offset_y / 2 * buffer->StrideU() +
+            rect.offset_x / 2,
+        buffer->StrideU(),
+        buffer->MutableDataV() + rect.offset_y / 2 * buffer->StrideV() +
+            rect.offset_x / 2,
+        buffer->StrideV(), rect.width, rect.height);
+  }
+
+  // The previous result, and the one before it, which is reused for the copy
+  // once the encoder has released it.
+  rtc::scoped_refptr<Buffer> last_buffer_;
+  rtc::scoped_refptr<Buffer> spare_buffer_;
+};
+
+}  // namespace webrtc
+
+#endif  // COMMON_VIDEO_INCLUDE_INCREMENTAL_I420_CONVERTER_H_
@@ -0,0 +1,298 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef COMMON_VIDEO_INCLUDE_SCALED_BUFFER_PYRAMID_H_
+#define COMMON_VIDEO_INCLUDE_SCALED_BUFFER_PYRAMID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "api/video/nv12_buffer.h"
+#include "api/video/video_frame_buffer.h"
+#include "rtc_base/ref_count.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/thread_annotations.h"
+
+namespace webrtc {
+
+// Per-frame cache of scaled versions of a VideoFrameBuffer.
+//
+// The simulcast layers of a frame, and the sinks of a frame asking for
+// different resolutions, all scale the same input. The pyramid produces each
+// requested resolution once and hands the same buffer to every consumer
+// asking for it. A new level is derived from the smallest existing level, the
+// source included, that covers the same crop rectangle and is at least as
+// large in both dimensions, so that e.g. the 180p layer is scaled from the
+// 360p layer rather than from 720p.
+//
+// Levels are only derived from I420 and NV12 buffers, which can be scaled in
+// memory; NV12 levels stay NV12. For other types, notably kNative, the
+// request is forwarded to the source's CropAndScale() and the result cached
+// as is.
+//
+// Thread safe. Scaling runs outside the lock, so consumers scaling to
+// different resolutions on different threads do not wait for each other.
+// Two consumers asking for a missing level at the same time may both scale
+// it; the first result is published and returned to both, so consumers still
+// share one buffer per level. The cache lives as long as the pyramid, which
+// buffers returned by Wrap() keep alive.
+class ScaledBufferPyramid : public rtc::RefCountInterface {
+ public:
+  struct Stats {
+    // Requests served from the cache, and levels that had to be scaled.
+    // Levels scaled twice by concurrent requests count as scaled twice.
+    size_t num_hits = 0;
+    size_t num_scaled = 0;
+  };
+
+  static rtc::scoped_refptr<ScaledBufferPyramid> Create(
+      rtc::scoped_refptr<VideoFrameBuffer> source) {
+    return new rtc::RefCountedObject<ScaledBufferPyramid>(std::move(source));
+  }
+
+  const rtc::scoped_refptr<VideoFrameBuffer>& source() const {
+    return source_;
+  }
+
+  // Returns a buffer with the content of source() whose Scale() and
+  // CropAndScale() are served by this pyramid. It has the same type as
+  // source() for I420 and NV12, and forwards all accessors to it; for other
+  // types source() itself is returned.
+  rtc::scoped_refptr<VideoFrameBuffer> Wrap();
+
+  // Same semantics as VideoFrameBuffer::CropAndScale() on source(). Returns
+  // source() itself if no cropping or scaling is needed.
+  rtc::scoped_refptr<VideoFrameBuffer> CropAndScale(int offset_x,
+                                                    int offset_y,
+                                                    int crop_width,
+                                                    int crop_height,
+                                                    int scaled_width,
+                                                    int scaled_height) {
+    if (offset_x == 0 && offset_y == 0 && crop_width == source_->width() &&
+        crop_height == source_->height() && scaled_width == crop_width &&
+        scaled_height == crop_height) {
+      return source_;
+    }
+    const Level key = {offset_x,    offset_y,     crop_width,
+                       crop_height, scaled_width, scaled_height,
+                       nullptr};
+    rtc::scoped_refptr<VideoFrameBuffer> parent;
+    {
+      MutexLock lock(&mutex_);
+      for (const Level& level : levels_) {
+        if (level.SameAs(key)) {
+          ++stats_.num_hits;
+          return level.buffer;
+        }
+      }
+      parent = FindParentLevel(key);
+    }
+
+    rtc::scoped_refptr<VideoFrameBuffer> scaled =
+        parent ? ScaleBuffer(parent.get(), 0, 0, parent->width(),
+                             parent->height(), scaled_width, scaled_height)
+               : ScaleBuffer(source_.get(), offset_x, offset_y, crop_width,
+                             crop_height, scaled_width, scaled_height);
+
+    MutexLock lock(&mutex_);
+    ++stats_.num_scaled;
+    for (const Level& level : levels_) {
+      if (level.SameAs(key))
+        return level.buffer;
+    }
+    levels_.push_back(key);
+    levels_.back().buffer = scaled;
+    return scaled;
+  }
+
+  rtc::scoped_refptr<VideoFrameBuffer> Scale(int scaled_width,
+                                             int scaled_height) {
+    return CropAndScale(0, 0, source_->width(), source_->height(),
+                        scaled_width, scaled_height);
+  }
+
+  Stats GetStats() const {
+    MutexLock lock(&mutex_);
+    return stats_;
+  }
+
+ protected:
+  explicit ScaledBufferPyramid(rtc::scoped_refptr<VideoFrameBuffer> source)
+      : source_(std::move(source)) {}
+  ~ScaledBufferPyramid() override = default;
+
+ private:
+  struct Level {
+    bool SameAs(const Level& o) const {
+      return offset_x == o.offset_x && offset_y == o.offset_y &&
+             crop_width == o.crop_width && crop_height == o.crop_height &&
+             width == o.width && height == o.height;
+    }
+
+    int offset_x;
+    int offset_y;
+    int crop_width;
+    int crop_height;
+    int width;
+    int height;
+    rtc::scoped_refptr<VideoFrameBuffer> buffer;
+  };
+
+  static bool CanScaleInMemory(const VideoFrameBuffer& buffer) {
+    return buffer.type() == VideoFrameBuffer::Type::kI420 ||
+           buffer.type() == VideoFrameBuffer::Type::kNV12;
+  }
+
+  // NV12 buffers are scaled into NV12, so that NV12 input stays NV12 for
+  // consumers that accept it.
+  static rtc::scoped_refptr<VideoFrameBuffer> ScaleBuffer(
+      VideoFrameBuffer* buffer,
+      int offset_x,
+      int offset_y,
+      int crop_width,
+      int crop_height,
+      int scaled_width,
+      int scaled_height) {
+    if (buffer->type() == VideoFrameBuffer::Type::kNV12) {
+      return CropAndScaleNV12(*buffer->GetNV12(), offset_x, offset_y,
+                              crop_width, crop_height, scaled_width,
+                              scaled_height);
+    }
+    return buffer->CropAndScale(offset_x, offset_y, crop_width, crop_height,
+                                scaled_width, scaled_height);
+  }
+
+  // Returns the smallest level of the crop rectangle of |key| that is at
+  // least as large as |key|, or nullptr to scale from source().
+  rtc::scoped_refptr<VideoFrameBuffer> FindParentLevel(const Level& key) const
+      RTC_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    const Level* parent = nullptr;
+    for (const Level& level : levels_) {
+      if (level.offset_x != key.offset_x || level.offset_y != key.offset_y ||
+          level.crop_width != key.crop_width ||
+          level.crop_height != key.crop_height || level.width < key.width ||
+          level.height < key.height || !CanScaleInMemory(*level.buffer)) {
+        continue;
+      }
+      if (!parent || static_cast<int64_t>(level.width) * level.height <
+                         static_cast<int64_t>(parent->width) * parent->height) {
+        parent = &level;
+      }
+    }
+    return parent ? parent->buffer : nullptr;
+  }
+
+  const rtc::scoped_refptr<VideoFrameBuffer> source_;
+  mutable Mutex mutex_;
+  std::vector<Level> levels_ RTC_GUARDED_BY(mutex_);
+  Stats stats_ RTC_GUARDED_BY(mutex_);
+};
+
+namespace scaled_buffer_pyramid_impl {
+
+// Buffers returned by ScaledBufferPyramid::Wrap(), forwarding the pixel data
+// of the source and scaling through the pyramid.
+class I420Buffer : public I420BufferInterface {
+ public:
+  explicit I420Buffer(rtc::scoped_refptr<ScaledBufferPyramid> pyramid)
+      : pyramid_(std::move(pyramid)),
+        source_(pyramid_->source()->GetI420()) {}
+
+  int width() const override { return source_->width(); }
+  int height() const override { return source_->height(); }
+  const uint8_t* DataY() const override { return source_->DataY(); }
+  const uint8_t* DataU() const override { return source_->DataU(); }
+  const uint8_t* DataV() const override { return source_->DataV(); }
+  int StrideY() const override { return source_->StrideY(); }
+  int StrideU() const override { return source_->StrideU(); }
+  int StrideV() const override { return source_->StrideV(); }
+
+  rtc::scoped_refptr<VideoFrameBuffer> CropAndScale(
+      int offset_x,
+      int offset_y,
+      int crop_width,
+      int crop_height,
+      int scaled_width,
+      int scaled_height) override {
+    return pyramid_->CropAndScale(offset_x, offset_y, crop_width, crop_height,
+                                  scaled_width, scaled_height);
+  }
+
+ private:
+  const rtc::scoped_refptr<ScaledBufferPyramid> pyramid_;
+  // Owned by |pyramid_|.
+  const I420BufferInterface* const source_;
+};
+
+class NV12Buffer : public NV12BufferInterface {
+ public:
+  explicit NV12Buffer(rtc::scoped_refptr<ScaledBufferPyramid> pyramid)
+      : pyramid_(std::move(pyramid)),
+        source_(pyramid_->source()->GetNV12()) {}
+
+  int width() const override { return source_->width(); }
+  int height() const override { return source_->height(); }
+  const uint8_t* DataY() const override { return source_->DataY(); }
+  const uint8_t* DataUV() const override { return source_->DataUV(); }
+  int StrideY() const override { return source_->StrideY(); }
+  int StrideUV() const override { return source_->StrideUV(); }
+
+  rtc::scoped_refptr<I420BufferInterface> ToI420() override {
+    return pyramid_->source()->ToI420();
+  }
+
+  rtc::scoped_refptr<VideoFrameBuffer> CropAndScale(
+      int offset_x,
+      int offset_y,
+      int crop_width,
+      int crop_height,
+      int scaled_width,
+      int scaled_height) override {
+    return pyramid_->CropAndScale(offset_x, offset_y, crop_width, crop_height,
+                                  scaled_width, scaled_height);
+  }
+
+ private:
+  const rtc::scoped_refptr<ScaledBufferPyramid> pyramid_;
+  // Owned by |pyramid_|.
+  const NV12BufferInterface* const source_;
+};
+
+}  // namespace scaled_buffer_pyramid_impl
+
+inline rtc::scoped_refptr<VideoFrameBuffer> ScaledBufferPyramid::Wrap() {
+  switch (source_->type()) {
+    case VideoFrameBuffer::Type::kI420:
+      return new rtc::RefCountedObject<scaled_buffer_pyramid_impl::I420Buffer>(
+          this);
+    case VideoFrameBuffer::Type::kNV12:
+      return new rtc::RefCountedObject<scaled_buffer_pyramid_impl::NV12Buffer>(
+          this);
+    default:
+      return source_;
+  }
+}
+
+// Shorthand for ScaledBufferPyramid::Create(buffer)->Wrap(), for handing one
+// frame to several consumers that scale it. Wrap each frame once; wrapping
+// a wrapped buffer again starts a new, empty pyramid.
+inline rtc::scoped_refptr<VideoFrameBuffer> WrapWithScaledBufferPyramid(
+    rtc::scoped_refptr<VideoFrameBuffer> buffer) {
+  return ScaledBufferPyramid::Create(std::move(buffer))->Wrap();
+}
+
+}  // namespace webrtc
+
+#endif  // COMMON_VIDEO_INCLUDE_SCALED_BUFFER_PYRAMID_H_
@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MEDIA_BASE_RECEIVED_PACKET_BATCHER_H_
+#define MEDIA_BASE_RECEIVED_PACKET_BATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "api/array_view.h"
+#include "api/task_queue/task_queue_base.h"
+#include "api/units/time_delta.h"
+#include "rtc_base/copy_on_write_buffer.h"
+#include "rtc_base/synchronization/mutex.h"
+#include "rtc_base/task_utils/pending_task_safety_flag.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/thread_annotations.h"
+#include "rtc_base/time_utils.h"
+
+namespace cricket {
+
+// Hands packets received on the network thread over to the worker thread in
+// batches, instead of posting one task per packet.
+//
+// The first packet added to an empty batch posts a task to |worker_queue|.
+// Packets arriving before that task runs, typically the rest of the same
+// socket read burst, are appended to the batch and delivered by the same
+// task. A packet is thus never delivered later than the task it would have
+// posted on its own: it joins a task that was posted earlier.
+//
+// |Config::max_batch_size| and |Config::max_batch_latency| do not bound the
+// delivery delay, which only depends on how busy the worker is. They bound
+// the work of a single task: a batch stops taking packets once it holds
+// |max_batch_size| packets, or once its first packet was added more than
+// |max_batch_latency| ago, and the next packet starts a new batch and task.
+// A backlogged worker so still interleaves other tasks between batches.
+//
+// Add() may be called on any thread. The batcher must be created and
+// destroyed on |worker_queue|; |deliver| is called there, and not after the
+// batcher has been destroyed. Packets pending at destruction are dropped.
+class ReceivedPacketBatcher {
+ public:
+  struct Packet {
+    rtc::CopyOnWriteBuffer packet;
+    int64_t packet_time_us = -1;
+  };
+  using DeliverCallback =
+      std::function<void(rtc::ArrayView<const Packet> packets)>;
+
+  struct Config {
+    size_t max_batch_size = 64;
+    webrtc::TimeDelta max_batch_latency = webrtc::TimeDelta::Millis(2);
+  };
+
+  ReceivedPacketBatcher(webrtc::TaskQueueBase* worker_queue,
+                        const Config& config,
+                        DeliverCallback deliver)
+      : worker_queue_(worker_queue),
+        config_(config),
+        deliver_(std::move(deliver)) {}
+  ReceivedPacketBatcher(const ReceivedPacketBatcher&) = delete;
+  ReceivedPacketBatcher& operator=(const ReceivedPacketBatcher&) = delete;
+
+  void Add(rtc::CopyOnWriteBuffer packet, int64_t packet_time_us) {
+    const int64_t now_us = rtc::TimeMicros();
+    bool post_task = false;
+    {
+      webrtc::MutexLock lock(&mutex_);
+      ++num_packets_;
+      if (pending_.empty() ||
+          pending_.back().packets.size() >= config_.max_batch_size ||
+          now_us - pending_.back().first_packet_time_us >
+              config_.max_batch_latency.us()) {
+        pending_.emplace_back();
+        Batch& batch = pending_.back();
+        if (!spare_.empty()) {
+          batch.packets = std::move(spare_.back());
+          spare_.pop_back();
+        }
+        batch.first_packet_time_us = now_us;
+        ++num_tasks_;
+        post_task = true;
+      }
+      pending_.back().packets.push_back(
+          Packet{std::move(packet), packet_time_us});
+    }
+    // Each task delivers the oldest pending batch, so the order in which
+    // concurrent Add() calls post their tasks does not matter.
+    if (post_task) {
+      worker_queue_->PostTask(
+          webrtc::ToQueuedTask(task_safety_, [this] { DeliverBatch(); }));
+    }
+  }
+
+  // Number of packets added and of tasks posted to the worker so far.
+  size_t num_packets() const {
+    webrtc::MutexLock lock(&mutex_);
+    return num_packets_;
+  }
+  size_t num_tasks() const {
+    webrtc::MutexLock lock(&mutex_);
+    return num_tasks_;
+  }
+
+ private:
+  struct Batch {
+    std::vector<Packet> packets;
+    int64_t first_packet_time_us = 0;
+  };
+
+  // Runs on |worker_queue_|. Packets added while the batch is delivered
+  // start a new batch, since the batch is no longer pending.
+  void DeliverBatch() {
+    std::vector<Packet> packets;
+    {
+      webrtc::MutexLock lock(&mutex_);
+      packets = std::move(pending_.front().packets);
+      pending_.pop_front();
+    }
+    deliver_(packets);
+    // Hand the vector back for reuse, so that steady state batching does not
+    // allocate.
+    packets.clear();
+    webrtc::MutexLock lock(&mutex_);
+    spare_.push_back(std::move(packets));
+  }
+
+  webrtc::TaskQueueBase* const worker_queue_;
+  const Config config_;
+  const DeliverCallback deliver_;
+
+  mutable webrtc::Mutex mutex_;
+  // Batches waiting for their task to run, oldest first. Only the last one
+  // takes new packets.
+  std::deque<Batch> pending_ RTC_GUARDED_BY(mutex_);
+  std::vector<std::vector<Packet>> spare_ RTC_GUARDED_BY(mutex_);
+  size_t num_packets_ RTC_GUARDED_BY(mutex_) = 0;
+  size_t num_tasks_ RTC_GUARDED_BY(mutex_) = 0;
+
+  // Last, so that tasks are cancelled before the members they use go away.
+  webrtc::ScopedTaskSafety task_safety_;
+};
+
+}  // namespace cricket
+
+#endif  // MEDIA_BASE_RECEIVED_PACKET_BATCHER_H_
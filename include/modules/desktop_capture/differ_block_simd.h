@@ -0,0 +1,164 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MODULES_DESKTOP_CAPTURE_DIFFER_BLOCK_SIMD_H_
+#define MODULES_DESKTOP_CAPTURE_DIFFER_BLOCK_SIMD_H_
+
+// Defines WEBRTC_ARCH_X86_FAMILY, used below.
+#include "rtc_base/system/arch.h"
+
+#if defined(WEBRTC_HAS_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <immintrin.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+
+#include "modules/desktop_capture/differ_block.h"
+#include "rtc_base/system/avx2_target.h"
+#include "system_wrappers/include/simd_optimization.h"
+
+namespace webrtc {
+
+// Inline versions of BlockDifference() for callers that diff frames outside
+// DesktopCapturerDifferWrapper, e.g. in an application's capture pipeline.
+//
+// Each function compares two blocks of kBlockSize x |height| pixels, whose
+// rows are |stride| bytes apart, and returns whether they differ. A row of a
+// block is 128 bytes: the SSE2 and NEON kernels compare it in 8 loads of 16
+// bytes, the AVX2 kernel in 4 loads of 32 bytes. The SIMD kernels compare
+// two rows per iteration and test for a difference once per pair.
+
+constexpr int kBlockRowBytes = kBlockSize * kBytesPerPixel;
+
+inline bool BlockDifference_C(const uint8_t* image1,
+                              const uint8_t* image2,
+                              int height,
+                              int stride) {
+  for (int i = 0; i < height; ++i) {
+    if (memcmp(image1, image2, kBlockRowBytes) != 0)
+      return true;
+    image1 += stride;
+    image2 += stride;
+  }
+  return false;
+}
+
+#if defined(WEBRTC_HAS_NEON)
+inline bool BlockDifference_Neon(const uint8_t* image1,
+                                 const uint8_t* image2,
+                                 int height,
+                                 int stride) {
+  int i = 0;
+  for (; i + 2 <= height; i += 2) {
+    uint8x16_t acc = vdupq_n_u8(0);
+    for (int row = 0; row < 2; ++row) {
+      const uint8_t* a = image1 + row * stride;
+      const uint8_t* b = image2 + row * stride;
+      for (int k = 0; k < kBlockRowBytes; k += 16)
+        acc = vorrq_u8(acc, veorq_u8(vld1q_u8(a + k), vld1q_u8(b + k)));
+    }
+    const uint64x2_t acc64 = vreinterpretq_u64_u8(acc);
+    if ((vgetq_lane_u64(acc64, 0) | vgetq_lane_u64(acc64, 1)) != 0)
+      return true;
+    image1 += 2 * stride;
+    image2 += 2 * stride;
+  }
+  return BlockDifference_C(image1, image2, height - i, stride);
+}
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+inline bool BlockDifference_Sse2(const uint8_t* image1,
+                                 const uint8_t* image2,
+                                 int height,
+                                 int stride) {
+  int i = 0;
+  for (; i + 2 <= height; i += 2) {
+    __m128i acc = _mm_setzero_si128();
+    for (int row = 0; row < 2; ++row) {
+      const uint8_t* a = image1 + row * stride;
+      const uint8_t* b = image2 + row * stride;
+      for (int k = 0; k < kBlockRowBytes; k += 16) {
+        acc = _mm_or_si128(
+            acc,
+            _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k))));
+      }
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) !=
+        0xFFFF) {
+      return true;
+    }
+    image1 += 2 * stride;
+    image2 += 2 * stride;
+  }
+  return BlockDifference_C(image1, image2, height - i, stride);
+}
+#endif
+
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+WEBRTC_AVX2_TARGET inline bool BlockDifference_Avx2(const uint8_t* image1,
+                                                    const uint8_t* image2,
+                                                    int height,
+                                                    int stride) {
+  int i = 0;
+  for (; i + 2 <= height; i += 2) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int row = 0; row < 2; ++row) {
+      const uint8_t* a = image1 + row * stride;
+      const uint8_t* b = image2 + row * stride;
+      for (int k = 0; k < kBlockRowBytes; k += 32) {
+        acc = _mm256_or_si256(
+            acc,
+            _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + k)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + k))));
+      }
+    }
+    if (!_mm256_testz_si256(acc, acc))
+      return true;
+    image1 += 2 * stride;
+    image2 += 2 * stride;
+  }
+  return BlockDifference_C(image1, image2, height - i, stride);
+}
+#endif
+
+// Runs the kernel for |optimization|, usually DetectSimdOptimization().
+inline bool BlockDifferenceSimd(SimdOptimization optimization,
+                                const uint8_t* image1,
+                                const uint8_t* image2,
+                                int height,
+                                int stride) {
+  switch (optimization) {
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+    case SimdOptimization::kAvx2:
+      return BlockDifference_Avx2(image1, image2, height, stride);
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    case SimdOptimization::kSse2:
+      return BlockDifference_Sse2(image1, image2, height, stride);
+#endif
+#if defined(WEBRTC_HAS_NEON)
+    case SimdOptimization::kNeon:
+      return BlockDifference_Neon(image1, image2, height, stride);
+#endif
+    default:
+      return BlockDifference_C(image1, image2, height, stride);
+  }
+}
+
+}  // namespace webrtc
+
+#endif  // MODULES_DESKTOP_CAPTURE_DIFFER_BLOCK_SIMD_H_
@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MODULES_DESKTOP_CAPTURE_PARALLEL_BLOCK_DIFFER_H_
+#define MODULES_DESKTOP_CAPTURE_PARALLEL_BLOCK_DIFFER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "modules/desktop_capture/desktop_frame.h"
+#include "modules/desktop_capture/desktop_geometry.h"
+#include "modules/desktop_capture/desktop_region.h"
+#include "modules/desktop_capture/differ_block.h"
+#include "modules/desktop_capture/differ_block_simd.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/event.h"
+#include "rtc_base/platform_thread.h"
+#include "system_wrappers/include/simd_optimization.h"
+
+namespace webrtc {
+
+// Finds the kBlockSize x kBlockSize blocks that differ between two frames,
+// for callers that diff frames outside DesktopCapturerDifferWrapper, e.g. of
+// 4K or multi-monitor captures, where one thread takes several ms per frame.
+//
+// The rows of blocks are split into one band per thread. The calling thread
+// diffs the first band and |num_threads| - 1 worker threads, started by the
+// constructor, the others. Each band is compared with BlockDifferenceSimd().
+// Blocks on the right and bottom edge of a frame whose size is not a multiple
+// of kBlockSize are compared at their clipped size.
+//
+// Above cache size the diff is memory bound, so the gain from more threads
+// levels off once they saturate the memory bandwidth.
+//
+// Must be created, used and destroyed on the same thread.
+class ParallelBlockDiffer {
+ public:
+  explicit ParallelBlockDiffer(int num_threads)
+      : optimization_(DetectSimdOptimization()),
+        bands_(std::max(num_threads, 1)) {
+    RTC_DCHECK_GE(num_threads, 1);
+    for (size_t i = 1; i < bands_.size(); ++i) {
+      workers_.push_back(std::make_unique<Worker>(this, &bands_[i]));
+      workers_.back()->thread.Start();
+    }
+  }
+  ParallelBlockDiffer(const ParallelBlockDiffer&) = delete;
+  ParallelBlockDiffer& operator=(const ParallelBlockDiffer&) = delete;
+
+  ~ParallelBlockDiffer() {
+    quit_ = true;
+    for (const auto& worker : workers_) {
+      worker->start.Set();
+      worker->thread.Stop();
+    }
+  }
+
+  // Adds the blocks of |new_frame| that differ from |old_frame| to
+  // |updated_region|, with horizontally adjacent blocks merged into one
+  // rectangle. The whole frame is added if the size or stride changed.
+  void Diff(const DesktopFrame& old_frame,
+            const DesktopFrame& new_frame,
+            DesktopRegion* updated_region) {
+    if (!old_frame.size().equals(new_frame.size()) ||
+        old_frame.stride() != new_frame.stride()) {
+      updated_region->AddRect(DesktopRect::MakeSize(new_frame.size()));
+      return;
+    }
+    old_frame_ = &old_frame;
+    new_frame_ = &new_frame;
+    const int block_rows =
+        (new_frame.size().height() + kBlockSize - 1) / kBlockSize;
+    const int num_bands =
+        std::min(static_cast<int>(bands_.size()), std::max(block_rows, 1));
+    for (int i = 0; i < num_bands; ++i) {
+      bands_[i].first_block_row = block_rows * i / num_bands;
+      bands_[i].end_block_row = block_rows * (i + 1) / num_bands;
+    }
+    // The event hands the frames and band over to the worker.
+    for (int i = 1; i < num_bands; ++i)
+      workers_[i - 1]->start.Set();
+    DiffBand(&bands_[0]);
+    for (int i = 1; i < num_bands; ++i)
+      workers_[i - 1]->done.Wait(rtc::Event::kForever);
+    for (int i = 0; i < num_bands; ++i) {
+      const std::vector<DesktopRect>& rects = bands_[i].updated_rects;
+      updated_region->AddRects(rects.data(), static_cast<int>(rects.size()));
+    }
+    old_frame_ = nullptr;
+    new_frame_ = nullptr;
+  }
+
+ private:
+  struct Band {
+    int first_block_row = 0;
+    int end_block_row = 0;
+    std::vector<DesktopRect> updated_rects;
+  };
+
+  struct Worker {
+    Worker(ParallelBlockDiffer* differ, Band* band)
+        : differ(differ),
+          band(band),
+          thread(&Worker::Run, this, "ParallelBlockDiffer") {}
+
+    static void Run(void* obj) {
+      Worker* worker = static_cast<Worker*>(obj);
+      while (true) {
+        worker->start.Wait(rtc::Event::kForever);
+        if (worker->differ->quit_)
+          return;
+        worker->differ->DiffBand(worker->band);
+        worker->done.Set();
+      }
+    }
+
+    ParallelBlockDiffer* const differ;
+    Band* const band;
+    rtc::Event start;
+    rtc::Event done;
+    rtc::PlatformThread thread;
+  };
+
+  // Compares a block clipped by the frame's right edge to |width_bytes|.
+  static bool PartialBlockDifference(const uint8_t* image1,
+                                     const uint8_t* image2,
+                                     int width_bytes,
+                                     int height,
+                                     int stride) {
+    for (int i = 0; i < height; ++i) {
+      if (memcmp(image1, image2, width_bytes) != 0)
+        return true;
+      image1 += stride;
+      image2 += stride;
+    }
+    return false;
+  }
+
+  void DiffBand(Band* band) const {
+    band->updated_rects.clear();
+    const int width = new_frame_->size().width();
+    const int height = new_frame_->size().height();
+    const int stride = new_frame_->stride();
+    for (int block_row = band->first_block_row;
+         block_row < band->end_block_row; ++block_row) {
+      const int top = block_row * kBlockSize;
+      const int bottom = std::min(top + kBlockSize, height);
+      const uint8_t* old_row = old_frame_->data() + top * stride;
+      const uint8_t* new_row = new_frame_->data() + top * stride;
+      // Left edge of the run of changed blocks being built, or -1.
+      int run_left = -1;
+      for (int left = 0; left < width; left += kBlockSize) {
+        const int offset = left * DesktopFrame::kBytesPerPixel;
+        const bool changed =
+            left + kBlockSize <= width
+                ? BlockDifferenceSimd(optimization_, old_row + offset,
+                                      new_row + offset, bottom - top, stride)
+                : PartialBlockDifference(
+                      old_row + offset, new_row + offset,
+                      (width - left) * DesktopFrame::kBytesPerPixel,
+                      bottom - top, stride);
+        if (changed && run_left < 0) {
+          run_left = left;
+        } else if (!changed && run_left >= 0) {
+          band->updated_rects.push_back(
+              DesktopRect::MakeLTRB(run_left, top, left, bottom));
+          run_left = -1;
+        }
+      }
+      if (run_left >= 0) {
+        band->updated_rects.push_back(
+            DesktopRect::MakeLTRB(run_left, top, width, bottom));
+      }
+    }
+  }
+
+  const SimdOptimization optimization_;
+  // Band i is diffed by the calling thread if i is 0, else by workers_[i - 1].
+  std::vector<Band> bands_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // Set by Diff() before the workers are started, and read by them.
+  const DesktopFrame* old_frame_ = nullptr;
+  const DesktopFrame* new_frame_ = nullptr;
+  // Set by the destructor before the workers are woken up to exit.
+  bool quit_ = false;
+};
+
+}  // namespace webrtc
+
+#endif  // MODULES_DESKTOP_CAPTURE_PARALLEL_BLOCK_DIFFER_H_
@@ -0,0 +1,211 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MODULES_RTP_RTCP_SOURCE_FEC_XOR_H_
+#define MODULES_RTP_RTCP_SOURCE_FEC_XOR_H_
+
+// Defines WEBRTC_ARCH_X86_FAMILY, used below.
+#include "rtc_base/system/arch.h"
+
+#if defined(WEBRTC_HAS_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <immintrin.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "api/array_view.h"
+#include "rtc_base/system/avx2_target.h"
+#include "system_wrappers/include/simd_optimization.h"
+
+namespace webrtc {
+namespace internal {
+
+// XOR kernels for generating FEC payloads and recovering lost media packets.
+// The kernels have no alignment requirements. Sources and destinations must
+// not overlap.
+
+// dst[i] ^= src[i] for i in [0, length).
+inline void XorBytes_C(const uint8_t* src, size_t length, uint8_t* dst) {
+  size_t i = 0;
+  // Word-sized XOR through memcpy, which compilers turn into plain unaligned
+  // loads and stores.
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t s;
+    uint64_t d;
+    memcpy(&s, src + i, sizeof(s));
+    memcpy(&d, dst + i, sizeof(d));
+    d ^= s;
+    memcpy(dst + i, &d, sizeof(d));
+  }
+  for (; i < length; ++i) {
+    dst[i] ^= src[i];
+  }
+}
+
+#if defined(WEBRTC_HAS_NEON)
+inline void XorBytes_Neon(const uint8_t* src, size_t length, uint8_t* dst) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+  }
+  XorBytes_C(src + i, length - i, dst + i);
+}
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+inline void XorBytes_Sse2(const uint8_t* src, size_t length, uint8_t* dst) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i d =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(d, s));
+  }
+  XorBytes_C(src + i, length - i, dst + i);
+}
+#endif
+
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+WEBRTC_AVX2_TARGET inline void XorBytes_Avx2(const uint8_t* src,
+                                              size_t length,
+                                              uint8_t* dst) {
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    const __m256i d =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_xor_si256(d, s));
+  }
+  XorBytes_Sse2(src + i, length - i, dst + i);
+}
+#endif
+
+// dst[i] ^= src[i] for each destination in |dsts|, for adding a media packet
+// to every FEC packet whose mask covers it. The 16 byte kernels load each
+// vector of |src| once and XOR it into all destinations; the others make one
+// pass per destination, which measured faster for them since the compiler
+// vectorizes the single destination loop of XorBytes_C, and AVX2 only takes a
+// few dozen iterations per packet. The destinations must not alias each other.
+inline void XorBytesMulti_C(const uint8_t* src,
+                            size_t length,
+                            rtc::ArrayView<uint8_t* const> dsts) {
+  for (uint8_t* dst : dsts) {
+    XorBytes_C(src, length, dst);
+  }
+}
+
+#if defined(WEBRTC_HAS_NEON)
+inline void XorBytesMulti_Neon(const uint8_t* src,
+                               size_t length,
+                               rtc::ArrayView<uint8_t* const> dsts) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const uint8x16_t s = vld1q_u8(src + i);
+    for (uint8_t* dst : dsts) {
+      vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), s));
+    }
+  }
+  for (uint8_t* dst : dsts) {
+    XorBytes_C(src + i, length - i, dst + i);
+  }
+}
+#endif
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+inline void XorBytesMulti_Sse2(const uint8_t* src,
+                               size_t length,
+                               rtc::ArrayView<uint8_t* const> dsts) {
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    for (uint8_t* dst : dsts) {
+      __m128i* d = reinterpret_cast<__m128i*>(dst + i);
+      _mm_storeu_si128(d, _mm_xor_si128(_mm_loadu_si128(d), s));
+    }
+  }
+  for (uint8_t* dst : dsts) {
+    XorBytes_C(src + i, length - i, dst + i);
+  }
+}
+#endif
+
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+inline void XorBytesMulti_Avx2(const uint8_t* src,
+                               size_t length,
+                               rtc::ArrayView<uint8_t* const> dsts) {
+  for (uint8_t* dst : dsts) {
+    XorBytes_Avx2(src, length, dst);
+  }
+}
+#endif
+
+// Run the kernels for |optimization|, usually DetectSimdOptimization().
+inline void XorBytes(SimdOptimization optimization,
+                     const uint8_t* src,
+                     size_t length,
+                     uint8_t* dst) {
+  switch (optimization) {
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+    case SimdOptimization::kAvx2:
+      XorBytes_Avx2(src, length, dst);
+      return;
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    case SimdOptimization::kSse2:
+      XorBytes_Sse2(src, length, dst);
+      return;
+#endif
+#if defined(WEBRTC_HAS_NEON)
+    case SimdOptimization::kNeon:
+      XorBytes_Neon(src, length, dst);
+      return;
+#endif
+    default:
+      XorBytes_C(src, length, dst);
+  }
+}
+
+inline void XorBytesMulti(SimdOptimization optimization,
+                          const uint8_t* src,
+                          size_t length,
+                          rtc::ArrayView<uint8_t* const> dsts) {
+  switch (optimization) {
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+    case SimdOptimization::kAvx2:
+      XorBytesMulti_Avx2(src, length, dsts);
+      return;
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+    case SimdOptimization::kSse2:
+      XorBytesMulti_Sse2(src, length, dsts);
+      return;
+#endif
+#if defined(WEBRTC_HAS_NEON)
+    case SimdOptimization::kNeon:
+      XorBytesMulti_Neon(src, length, dsts);
+      return;
+#endif
+    default:
+      XorBytesMulti_C(src, length, dsts);
+  }
+}
+
+}  // namespace internal
+}  // namespace webrtc
+
+#endif  // MODULES_RTP_RTCP_SOURCE_FEC_XOR_H_
@@ -0,0 +1,223 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MODULES_RTP_RTCP_SOURCE_GF256_H_
+#define MODULES_RTP_RTCP_SOURCE_GF256_H_
+
+// Defines WEBRTC_ARCH_X86_FAMILY, used below.
+#include "rtc_base/system/arch.h"
+
+#if defined(WEBRTC_HAS_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <immintrin.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtc_base/checks.h"
+#include "rtc_base/system/avx2_target.h"
+#include "system_wrappers/include/simd_optimization.h"
+
+namespace webrtc {
+namespace gf256 {
+
+// Arithmetic in GF(2^8) with the primitive polynomial
+// x^8 + x^4 + x^3 + x^2 + 1 (0x11d), as used by ReedSolomonErasureCode.
+
+struct Tables {
+  Tables() {
+    int x = 1;
+    for (int i = 0; i < 255; ++i) {
+      exp[i] = static_cast<uint8_t>(x);
+      exp[i + 255] = static_cast<uint8_t>(x);
+      log[x] = static_cast<uint8_t>(i);
+      x <<= 1;
+      if (x & 0x100)
+        x ^= 0x11d;
+    }
+    exp[510] = exp[0];
+    exp[511] = exp[1];
+    log[0] = 0;
+  }
+
+  // exp[] is doubled so that exp[log[a] + log[b]] needs no modulo.
+  uint8_t exp[512];
+  uint8_t log[256];
+};
+
+inline const Tables& GetTables() {
+  static const Tables tables;
+  return tables;
+}
+
+// Addition and subtraction in GF(2^8) are both XOR.
+inline uint8_t Add(uint8_t a, uint8_t b) {
+  return a ^ b;
+}
+
+inline uint8_t Mul(uint8_t a, uint8_t b) {
+  if (a == 0 || b == 0)
+    return 0;
+  const Tables& t = GetTables();
+  return t.exp[t.log[a] + t.log[b]];
+}
+
+// Division by zero and the inverse of zero are not defined.
+inline uint8_t Div(uint8_t a, uint8_t b) {
+  RTC_DCHECK_NE(b, 0);
+  if (a == 0)
+    return 0;
+  const Tables& t = GetTables();
+  return t.exp[t.log[a] + 255 - t.log[b]];
+}
+
+inline uint8_t Inv(uint8_t a) {
+  RTC_DCHECK_NE(a, 0);
+  const Tables& t = GetTables();
+  return t.exp[255 - t.log[a]];
+}
+
+// Products of |c| with every low nibble, and with every high nibble, so that
+// c * x = low[x & 0xf] ^ high[x >> 4].
+struct NibbleTables {
+  explicit NibbleTables(uint8_t c) {
+    for (int i = 0; i < 16; ++i) {
+      low[i] = Mul(c, static_cast<uint8_t>(i));
+      high[i] = Mul(c, static_cast<uint8_t>(i << 4));
+    }
+  }
+
+  uint8_t low[16];
+  uint8_t high[16];
+};
+
+// dst[i] ^= c * src[i] for i in [0, length). This is the inner loop of both
+// Reed-Solomon encoding and decoding. |src| and |dst| may not overlap and
+// have no alignment requirements.
+inline void MulAdd_C(uint8_t c, const uint8_t* src, size_t length,
+                     uint8_t* dst) {
+  if (c == 0)
+    return;
+  if (c == 1) {
+    for (size_t i = 0; i < length; ++i)
+      dst[i] ^= src[i];
+    return;
+  }
+  // Expanding the nibble tables to all 256 products takes 256 XORs and
+  // halves the lookups per byte.
+  const NibbleTables tables(c);
+  uint8_t products[256];
+  for (int h = 0; h < 16; ++h) {
+    for (int l = 0; l < 16; ++l)
+      products[h << 4 | l] = tables.high[h] ^ tables.low[l];
+  }
+  for (size_t i = 0; i < length; ++i)
+    dst[i] ^= products[src[i]];
+}
+
+#if defined(WEBRTC_HAS_NEON)
+inline void MulAdd_Neon(uint8_t c,
+                        const uint8_t* src,
+                        size_t length,
+                        uint8_t* dst) {
+  const NibbleTables tables(c);
+  const uint8x16_t mask = vdupq_n_u8(0x0f);
+#if defined(WEBRTC_ARCH_ARM64)
+  const uint8x16_t low = vld1q_u8(tables.low);
+  const uint8x16_t high = vld1q_u8(tables.high);
+#else
+  const uint8x8x2_t low = {{vld1_u8(tables.low), vld1_u8(tables.low + 8)}};
+  const uint8x8x2_t high = {{vld1_u8(tables.high), vld1_u8(tables.high + 8)}};
+#endif
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const uint8x16_t s = vld1q_u8(src + i);
+    const uint8x16_t s_low = vandq_u8(s, mask);
+    const uint8x16_t s_high = vshrq_n_u8(s, 4);
+#if defined(WEBRTC_ARCH_ARM64)
+    const uint8x16_t product =
+        veorq_u8(vqtbl1q_u8(low, s_low), vqtbl1q_u8(high, s_high));
+#else
+    const uint8x16_t product = veorq_u8(
+        vcombine_u8(vtbl2_u8(low, vget_low_u8(s_low)),
+                    vtbl2_u8(low, vget_high_u8(s_low))),
+        vcombine_u8(vtbl2_u8(high, vget_low_u8(s_high)),
+                    vtbl2_u8(high, vget_high_u8(s_high))));
+#endif
+    vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), product));
+  }
+  for (; i < length; ++i)
+    dst[i] ^= tables.low[src[i] & 0xf] ^ tables.high[src[i] >> 4];
+}
+#endif
+
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+WEBRTC_AVX2_TARGET inline void MulAdd_Avx2(uint8_t c,
+                                            const uint8_t* src,
+                                            size_t length,
+                                            uint8_t* dst) {
+  const NibbleTables tables(c);
+  // vpshufb looks up within each 128 bit lane, so both lanes get the tables.
+  const __m256i low = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.low)));
+  const __m256i high = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.high)));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    const __m256i s_low = _mm256_and_si256(s, mask);
+    const __m256i s_high = _mm256_and_si256(_mm256_srli_epi64(s, 4), mask);
+    const __m256i product = _mm256_xor_si256(_mm256_shuffle_epi8(low, s_low),
+                                             _mm256_shuffle_epi8(high, s_high));
+    __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+    _mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(d), product));
+  }
+  for (; i < length; ++i)
+    dst[i] ^= tables.low[src[i] & 0xf] ^ tables.high[src[i] >> 4];
+}
+#endif
+
+// Runs the kernel for |optimization|, usually DetectSimdOptimization(). There
+// is no SSE2 kernel, since the nibble lookups need SSSE3, which GetCPUInfo()
+// cannot detect; kSse2 uses the table based C kernel.
+inline void MulAdd(SimdOptimization optimization,
+                   uint8_t c,
+                   const uint8_t* src,
+                   size_t length,
+                   uint8_t* dst) {
+  // Multiplying by 0 or 1 needs no table lookups.
+  if (c <= 1) {
+    MulAdd_C(c, src, length, dst);
+    return;
+  }
+  switch (optimization) {
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+    case SimdOptimization::kAvx2:
+      MulAdd_Avx2(c, src, length, dst);
+      return;
+#endif
+#if defined(WEBRTC_HAS_NEON)
+    case SimdOptimization::kNeon:
+      MulAdd_Neon(c, src, length, dst);
+      return;
+#endif
+    default:
+      MulAdd_C(c, src, length, dst);
+  }
+}
+
+}  // namespace gf256
+}  // namespace webrtc
+
+#endif  // MODULES_RTP_RTCP_SOURCE_GF256_H_
@@ -0,0 +1,214 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MODULES_RTP_RTCP_SOURCE_REED_SOLOMON_FEC_H_
+#define MODULES_RTP_RTCP_SOURCE_REED_SOLOMON_FEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "api/array_view.h"
+#include "modules/rtp_rtcp/source/gf256.h"
+#include "rtc_base/checks.h"
+#include "system_wrappers/include/simd_optimization.h"
+
+namespace webrtc {
+
+// Maximum number of data and repair symbols of a ReedSolomonErasureCode
+// generation. The x_r and y_j below must be distinct elements of GF(2^8).
+constexpr size_t kReedSolomonMaxDataSymbols = 128;
+constexpr size_t kReedSolomonMaxRepairSymbols = 128;
+
+// Systematic Cauchy Reed-Solomon erasure code over GF(2^8). Unlike the
+// XOR-based ULPFEC/FlexFEC masks, any K of the K data symbols and M repair
+// symbols of a generation are sufficient to recover all K data symbols, which
+// makes the code robust against burst loss at a much lower overhead.
+//
+// A symbol is a byte array; all symbols of a generation have the same size.
+// To protect RTP packets, each packet is padded to the size of the largest
+// one, and its length carried in the symbol, by the packetization using the
+// code.
+//
+// Repair symbol r is the sum over data symbols j of C(r, j) * data[j], with
+// the Cauchy coefficients C(r, j) = 1 / (x_r + y_j), x_r = 128 + r and
+// y_j = j. The coefficients do not depend on K or M, so a receiver only needs
+// to know the indices of the symbols it got.
+class ReedSolomonErasureCode {
+ public:
+  struct ReceivedSymbol {
+    // Data symbols have indices [0, K), repair symbol r has index K + r.
+    size_t index;
+    const uint8_t* data;
+  };
+
+  ReedSolomonErasureCode() : ReedSolomonErasureCode(DetectSimdOptimization()) {}
+  explicit ReedSolomonErasureCode(SimdOptimization optimization)
+      : optimization_(optimization) {}
+
+  static uint8_t CauchyCoefficient(size_t repair_index, size_t data_index) {
+    return gf256::Inv(static_cast<uint8_t>(
+        (kReedSolomonMaxDataSymbols + repair_index) ^ data_index));
+  }
+
+  // Computes one repair symbol of |symbol_size| bytes into each of |repair|,
+  // repair[r] getting row r, from the data symbols in |data|.
+  //
+  // Returns false, leaving |repair| untouched, if there are more than
+  // kReedSolomonMaxDataSymbols data or kReedSolomonMaxRepairSymbols repair
+  // symbols.
+  bool Encode(rtc::ArrayView<const uint8_t* const> data,
+              size_t symbol_size,
+              rtc::ArrayView<uint8_t* const> repair) const {
+    if (data.size() > kReedSolomonMaxDataSymbols ||
+        repair.size() > kReedSolomonMaxRepairSymbols) {
+      return false;
+    }
+    for (size_t r = 0; r < repair.size(); ++r) {
+      memset(repair[r], 0, symbol_size);
+      for (size_t j = 0; j < data.size(); ++j) {
+        gf256::MulAdd(optimization_, CauchyCoefficient(r, j), data[j],
+                      symbol_size, repair[r]);
+      }
+    }
+    return true;
+  }
+
+  // Recovers the data symbols of a generation of |num_data_symbols| that are
+  // missing from |received|. |received| holds at least as many repair
+  // symbols as there are data symbols missing; extra repair symbols are
+  // ignored. |missing| receives the recovered symbols of |symbol_size| bytes,
+  // in increasing order of their index, and must have one entry per missing
+  // data symbol.
+  //
+  // Returns false if |received| has too few or invalid symbols.
+  bool Decode(size_t num_data_symbols,
+              size_t symbol_size,
+              rtc::ArrayView<const ReceivedSymbol> received,
+              rtc::ArrayView<uint8_t* const> missing) const {
+    if (num_data_symbols > kReedSolomonMaxDataSymbols)
+      return false;
+    std::vector<const uint8_t*> data(num_data_symbols, nullptr);
+    std::vector<std::pair<size_t, const uint8_t*>> repair;
+    for (const ReceivedSymbol& symbol : received) {
+      if (symbol.index < num_data_symbols) {
+        data[symbol.index] = symbol.data;
+      } else if (symbol.index - num_data_symbols <
+                 kReedSolomonMaxRepairSymbols) {
+        repair.emplace_back(symbol.index - num_data_symbols, symbol.data);
+      } else {
+        return false;
+      }
+    }
+    std::vector<size_t> erased;
+    for (size_t j = 0; j < num_data_symbols; ++j) {
+      if (data[j] == nullptr)
+        erased.push_back(j);
+    }
+    const size_t e = erased.size();
+    if (missing.size() != e)
+      return false;
+    if (e == 0)
+      return true;
+    std::sort(repair.begin(), repair.end());
+    repair.erase(std::unique(repair.begin(), repair.end(),
+                             [](const std::pair<size_t, const uint8_t*>& a,
+                                const std::pair<size_t, const uint8_t*>& b) {
+                               return a.first == b.first;
+                             }),
+                 repair.end());
+    if (repair.size() < e)
+      return false;
+    repair.resize(e);
+
+    // With the received data symbols moved to the left hand side, repair
+    // symbol r gives syndrome[r] = sum over erased j of C(r, j) * data[j].
+    std::vector<uint8_t> syndromes(e * symbol_size);
+    for (size_t r = 0; r < e; ++r) {
+      uint8_t* syndrome = &syndromes[r * symbol_size];
+      memcpy(syndrome, repair[r].second, symbol_size);
+      for (size_t j = 0; j < num_data_symbols; ++j) {
+        if (data[j] != nullptr) {
+          gf256::MulAdd(optimization_, CauchyCoefficient(repair[r].first, j),
+                        data[j], symbol_size, syndrome);
+        }
+      }
+    }
+
+    // Every square submatrix of a Cauchy matrix is invertible.
+    std::vector<uint8_t> matrix(e * e);
+    for (size_t r = 0; r < e; ++r) {
+      for (size_t c = 0; c < e; ++c)
+        matrix[r * e + c] = CauchyCoefficient(repair[r].first, erased[c]);
+    }
+    if (!InvertMatrix(e, &matrix))
+      return false;
+
+    for (size_t c = 0; c < e; ++c) {
+      memset(missing[c], 0, symbol_size);
+      for (size_t r = 0; r < e; ++r) {
+        gf256::MulAdd(optimization_, matrix[c * e + r],
+                      &syndromes[r * symbol_size], symbol_size, missing[c]);
+      }
+    }
+    return true;
+  }
+
+  // Inverts the |size| x |size| row-major matrix in |matrix| in place using
+  // Gauss-Jordan elimination. Returns false if the matrix is singular.
+  static bool InvertMatrix(size_t size, std::vector<uint8_t>* matrix) {
+    RTC_DCHECK_EQ(matrix->size(), size * size);
+    std::vector<uint8_t>& m = *matrix;
+    std::vector<uint8_t> inverse(size * size, 0);
+    for (size_t i = 0; i < size; ++i)
+      inverse[i * size + i] = 1;
+    for (size_t col = 0; col < size; ++col) {
+      size_t pivot = col;
+      while (pivot < size && m[pivot * size + col] == 0)
+        ++pivot;
+      if (pivot == size)
+        return false;
+      if (pivot != col) {
+        std::swap_ranges(&m[pivot * size], &m[pivot * size] + size,
+                         &m[col * size]);
+        std::swap_ranges(&inverse[pivot * size],
+                         &inverse[pivot * size] + size, &inverse[col * size]);
+      }
+      const uint8_t scale = gf256::Inv(m[col * size + col]);
+      for (size_t k = 0; k < size; ++k) {
+        m[col * size + k] = gf256::Mul(m[col * size + k], scale);
+        inverse[col * size + k] = gf256::Mul(inverse[col * size + k], scale);
+      }
+      for (size_t row = 0; row < size; ++row) {
+        const uint8_t factor = m[row * size + col];
+        if (row == col || factor == 0)
+          continue;
+        for (size_t k = 0; k < size; ++k) {
+          m[row * size + k] ^= gf256::Mul(factor, m[col * size + k]);
+          inverse[row * size + k] ^=
+              gf256::Mul(factor, inverse[col * size + k]);
+        }
+      }
+    }
+    m.swap(inverse);
+    return true;
+  }
+
+ private:
+  const SimdOptimization optimization_;
+};
+
+}  // namespace webrtc
+
+#endif  // MODULES_RTP_RTCP_SOURCE_REED_SOLOMON_FEC_H_
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MODULES_VIDEO_CODING_UTILITY_ENCODER_THREADING_H_
+#define MODULES_VIDEO_CODING_UTILITY_ENCODER_THREADING_H_
+
+#include <algorithm>
+
+#include "absl/numeric/bits.h"
+#include "absl/types/optional.h"
+
+namespace webrtc {
+
+// Threading and speed settings for software encoders that support tiles,
+// such as libvpx VP9 and libaom AV1. Unset threading fields are chosen by
+// GetEncoderThreadingLayout().
+//
+// LibvpxVp9Encoder and the libaom AV1 encoder do not read this struct; only
+// encoders built by the application can honour it, e.g. by passing the
+// layout and |speed| to their codec library.
+struct VideoEncoderTuning {
+  bool operator==(const VideoEncoderTuning& other) const {
+    return max_threads == other.max_threads && row_mt == other.row_mt &&
+           log2_tile_columns == other.log2_tile_columns &&
+           log2_tile_rows == other.log2_tile_rows && speed == other.speed;
+  }
+  bool operator!=(const VideoEncoderTuning& other) const {
+    return !(*this == other);
+  }
+
+  // Upper bound on the number of encoder threads. Never more than the number
+  // of cores.
+  absl::optional<int> max_threads;
+  // Row based multithreading, which lets threads work on the rows of a tile
+  // in parallel and so scales beyond the number of tile columns.
+  absl::optional<bool> row_mt;
+  // Log2 of the number of tile columns and rows. Clamped to what the
+  // resolution allows.
+  absl::optional<int> log2_tile_columns;
+  absl::optional<int> log2_tile_rows;
+  // Codec specific speed preset, e.g. cpu-used for libvpx and libaom. Higher
+  // is faster and lower quality. Unset leaves the encoder's own choice.
+  absl::optional<int> speed;
+};
+
+struct EncoderThreadingLayout {
+  int num_threads = 1;
+  int log2_tile_columns = 0;
+  int log2_tile_rows = 0;
+  bool row_mt = false;
+};
+
+// Narrowest tile and largest tile counts that both VP9 and AV1 accept.
+constexpr int kEncoderThreadingMinTileWidth = 256;
+constexpr int kEncoderThreadingMaxLog2TileColumns = 6;
+constexpr int kEncoderThreadingMaxLog2TileRows = 2;
+
+// Returns the threading layout for a |width|x|height| encoder given
+// |number_of_cores|, with the fields set in |tuning| taking precedence.
+//
+// Tile columns: one per 640 pixels of width, rounded down to a power of two,
+// since the codecs only support power of two tile counts, and limited to
+// tiles of at least 256 pixels. So 640 pixels or less get 1 column, 1280 and
+// 1920 get 2, 2560 and 3840 get 4, and 5120 gets 8.
+// Tile rows: 2 above 1080 lines, where they let threads start on the lower
+// half of the frame without waiting for the rows above, and 1 otherwise.
+// Row based multithreading: enabled from 1280x720.
+// Threads: the number of cores, at most the number of tiles, or twice that
+// with row based multithreading, and at least 1.
+inline EncoderThreadingLayout GetEncoderThreadingLayout(
+    int width,
+    int height,
+    int number_of_cores,
+    const VideoEncoderTuning& tuning) {
+  EncoderThreadingLayout layout;
+  int max_log2_tile_columns = 0;
+  while (max_log2_tile_columns < kEncoderThreadingMaxLog2TileColumns &&
+         (width >> (max_log2_tile_columns + 1)) >=
+             kEncoderThreadingMinTileWidth) {
+    ++max_log2_tile_columns;
+  }
+  // bit_width(n) - 1 is floor(log2(n)) for n >= 1.
+  const int default_log2_tile_columns =
+      absl::bit_width(static_cast<unsigned>(std::max(width / 640, 1))) - 1;
+  layout.log2_tile_columns =
+      std::min(std::max(tuning.log2_tile_columns.value_or(
+                            default_log2_tile_columns),
+                        0),
+               max_log2_tile_columns);
+  layout.log2_tile_rows =
+      std::min(std::max(tuning.log2_tile_rows.value_or(height > 1080 ? 1 : 0),
+                        0),
+               kEncoderThreadingMaxLog2TileRows);
+  layout.row_mt = tuning.row_mt.value_or(width * height >= 1280 * 720);
+
+  const int num_tiles = 1 << (layout.log2_tile_columns + layout.log2_tile_rows);
+  int max_threads = layout.row_mt ? 2 * num_tiles : num_tiles;
+  if (tuning.max_threads)
+    max_threads = std::min(max_threads, *tuning.max_threads);
+  layout.num_threads = std::max(std::min(number_of_cores, max_threads), 1);
+  return layout;
+}
+
+}  // namespace webrtc
+
+#endif  // MODULES_VIDEO_CODING_UTILITY_ENCODER_THREADING_H_
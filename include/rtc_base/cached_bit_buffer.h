@@ -0,0 +1,291 @@
+/*
+ *  Copyright 2021 The WebRTC Project Authors. All rights reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef RTC_BASE_CACHED_BIT_BUFFER_H_
+#define RTC_BASE_CACHED_BIT_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+
+#include "absl/numeric/bits.h"
+#include "api/array_view.h"
+#include "rtc_base/byte_order.h"
+#include "rtc_base/checks.h"
+
+namespace rtc {
+
+// Forward-only bit reader that keeps up to 64 not yet consumed bits in a
+// register-sized cache and refills it a whole word at a time, instead of
+// assembling each value byte by byte like BitBuffer does. Exponential golomb
+// values are decoded by counting the leading zeros of the cache rather than by
+// reading one bit at a time.
+//
+// Unlike BitBuffer, errors are sticky: once a read runs past the end of the
+// data, all subsequent reads return 0 and Ok() returns false. This lets
+// parsers read a whole structure and check for failure once.
+// Byte order is assumed big-endian/network.
+class CachedBitReader {
+ public:
+  explicit CachedBitReader(rtc::ArrayView<const uint8_t> bytes)
+      : next_byte_(bytes.data()), remaining_bytes_(bytes.size()) {}
+  CachedBitReader(const CachedBitReader&) = delete;
+  CachedBitReader& operator=(const CachedBitReader&) = delete;
+
+  // Returns false if any read ran past the end of the data.
+  bool Ok() const { return ok_; }
+  // Number of bits that have not been read yet.
+  uint64_t RemainingBitCount() const {
+    return ok_ ? uint64_t{remaining_bytes_} * 8 + cached_bits_ : 0;
+  }
+
+  // Reads |bit_count| bits, at most 32, and returns them as the low bits of
+  // the result.
+  uint32_t ReadBits(size_t bit_count) {
+    RTC_DCHECK_LE(bit_count, 32);
+    if (bit_count == 0 || !ok_)
+      return 0;
+    if (cached_bits_ < bit_count) {
+      Refill();
+      if (cached_bits_ < bit_count) {
+        Invalidate();
+        return 0;
+      }
+    }
+    const uint32_t value = static_cast<uint32_t>(cache_ >> (64 - bit_count));
+    cache_ <<= bit_count;
+    cached_bits_ -= bit_count;
+    return value;
+  }
+  bool ReadBit() { return ReadBits(1) != 0; }
+
+  // Reads value in range [0, num_values - 1]. See BitBuffer::ReadNonSymmetric
+  // for the encoding.
+  uint32_t ReadNonSymmetric(uint32_t num_values) {
+    RTC_DCHECK_GT(num_values, 0);
+    RTC_DCHECK_LE(num_values, uint32_t{1} << 31);
+    if (num_values == 1)
+      return 0;
+    const int count_bits = absl::bit_width(num_values);
+    const uint32_t num_min_bits_values =
+        (uint32_t{1} << count_bits) - num_values;
+    const uint32_t value = ReadBits(count_bits - 1);
+    if (value < num_min_bits_values)
+      return value;
+    return (value << 1) + ReadBits(1) - num_min_bits_values;
+  }
+
+  // Reads unsigned and signed exponential golomb values. See
+  // BitBuffer::ReadExponentialGolomb for the encoding.
+  uint32_t ReadExponentialGolomb() {
+    if (!ok_)
+      return 0;
+    if (cached_bits_ < 32)
+      Refill();
+    // The value must fit in 32 bits, so at most 31 leading zeros. The refilled
+    // cache holds at least 57 bits, or all that are left.
+    const int zero_bit_count = absl::countl_zero(cache_);
+    if (zero_bit_count > 31 || static_cast<size_t>(zero_bit_count) >=
+                                   cached_bits_) {
+      Invalidate();
+      return 0;
+    }
+    cache_ <<= zero_bit_count;
+    cached_bits_ -= zero_bit_count;
+    return ReadBits(zero_bit_count + 1) - 1;
+  }
+  int32_t ReadSignedExponentialGolomb() {
+    const uint64_t unsigned_val = ReadExponentialGolomb();
+    if ((unsigned_val & 1) == 0)
+      return -static_cast<int32_t>(unsigned_val / 2);
+    return static_cast<int32_t>((unsigned_val + 1) / 2);
+  }
+
+  // Skips |bit_count| bits.
+  void ConsumeBits(uint64_t bit_count) {
+    if (!ok_)
+      return;
+    if (bit_count < cached_bits_) {
+      cache_ <<= bit_count;
+      cached_bits_ -= bit_count;
+      return;
+    }
+    bit_count -= cached_bits_;
+    cache_ = 0;
+    cached_bits_ = 0;
+    if (bit_count / 8 > remaining_bytes_) {
+      Invalidate();
+      return;
+    }
+    next_byte_ += bit_count / 8;
+    remaining_bytes_ -= bit_count / 8;
+    ReadBits(bit_count % 8);
+  }
+
+ private:
+  // Refills |cache_| from |next_byte_| so that it holds at least 57 bits, or
+  // all remaining bits if fewer are left.
+  void Refill() {
+    if (remaining_bytes_ >= 8) {
+      // Take as many whole bytes of the next big-endian word as fit.
+      const size_t byte_count = (64 - cached_bits_) / 8;
+      uint64_t word;
+      memcpy(&word, next_byte_, sizeof(word));
+      word = NetworkToHost64(word);
+      if (byte_count < 8)
+        word &= ~uint64_t{0} << (64 - 8 * byte_count);
+      cache_ |= word >> cached_bits_;
+      cached_bits_ += 8 * byte_count;
+      next_byte_ += byte_count;
+      remaining_bytes_ -= byte_count;
+      return;
+    }
+    while (cached_bits_ <= 56 && remaining_bytes_ > 0) {
+      cache_ |= uint64_t{*next_byte_} << (56 - cached_bits_);
+      cached_bits_ += 8;
+      ++next_byte_;
+      --remaining_bytes_;
+    }
+  }
+
+  // Marks the reader as failed and clears the cache.
+  void Invalidate() {
+    ok_ = false;
+    cache_ = 0;
+    cached_bits_ = 0;
+    remaining_bytes_ = 0;
+  }
+
+  const uint8_t* next_byte_;
+  size_t remaining_bytes_;
+  // Cached bits, left aligned: the next bit to read is the MSB of |cache_|.
+  uint64_t cache_ = 0;
+  size_t cached_bits_ = 0;
+  bool ok_ = true;
+};
+
+// Counterpart of CachedBitReader for writing. Bits are accumulated in a 64-bit
+// word and written out whole bytes at a time. Errors are sticky in the same
+// way: once a write does not fit, Ok() returns false and further writes are
+// ignored.
+class CachedBitWriter {
+ public:
+  explicit CachedBitWriter(rtc::ArrayView<uint8_t> bytes)
+      : bytes_(bytes.data()), byte_count_(bytes.size()) {}
+  CachedBitWriter(const CachedBitWriter&) = delete;
+  CachedBitWriter& operator=(const CachedBitWriter&) = delete;
+  // Flushes pending bits.
+  ~CachedBitWriter() { Flush(); }
+
+  bool Ok() const { return ok_; }
+
+  // Writes the |bit_count| low bits of |val|, at most 64.
+  void WriteBits(uint64_t val, size_t bit_count) {
+    RTC_DCHECK_LE(bit_count, 64);
+    if (bit_count == 0 || !ok_)
+      return;
+    if (byte_offset_ * 8 + pending_bits_ + bit_count > byte_count_ * 8) {
+      ok_ = false;
+      return;
+    }
+    if (bit_count < 64)
+      val &= (uint64_t{1} << bit_count) - 1;
+    size_t free_bits = 64 - pending_bits_;
+    if (bit_count > free_bits) {
+      // Fill the pending word with the high bits first.
+      pending_ |= val >> (bit_count - free_bits);
+      pending_bits_ = 64;
+      FlushWholeBytes();
+      bit_count -= free_bits;
+      val &= (uint64_t{1} << bit_count) - 1;
+      free_bits = 64 - pending_bits_;
+    }
+    pending_ |= val << (free_bits - bit_count);
+    pending_bits_ += bit_count;
+    FlushWholeBytes();
+  }
+
+  // Writes value in range [0, num_values - 1]. See
+  // BitBufferWriter::WriteNonSymmetric for the encoding.
+  void WriteNonSymmetric(uint32_t val, uint32_t num_values) {
+    RTC_DCHECK_LT(val, num_values);
+    RTC_DCHECK_LE(num_values, uint32_t{1} << 31);
+    if (num_values == 1)
+      return;
+    const int count_bits = absl::bit_width(num_values);
+    const uint32_t num_min_bits_values =
+        (uint32_t{1} << count_bits) - num_values;
+    if (val < num_min_bits_values) {
+      WriteBits(val, count_bits - 1);
+    } else {
+      WriteBits(val + num_min_bits_values, count_bits);
+    }
+  }
+
+  // Writes unsigned and signed exponential golomb values. Like
+  // BitBufferWriter, rejects UINT32_MAX and INT32_MIN, whose codes are longer
+  // than CachedBitReader accepts; Ok() then returns false.
+  void WriteExponentialGolomb(uint32_t val) {
+    if (val == std::numeric_limits<uint32_t>::max()) {
+      ok_ = false;
+      return;
+    }
+    const uint64_t val_plus_one = uint64_t{val} + 1;
+    const int bit_count = absl::bit_width(val_plus_one);
+    WriteBits(0, bit_count - 1);
+    WriteBits(val_plus_one, bit_count);
+  }
+  void WriteSignedExponentialGolomb(int32_t val) {
+    if (val == std::numeric_limits<int32_t>::min()) {
+      ok_ = false;
+      return;
+    }
+    const int64_t signed_val = val;
+    if (signed_val > 0) {
+      WriteExponentialGolomb(static_cast<uint32_t>(signed_val * 2 - 1));
+    } else {
+      WriteExponentialGolomb(static_cast<uint32_t>(-signed_val * 2));
+    }
+  }
+
+  // Writes the pending bits to the buffer, padding the last partial byte with
+  // zeros, and returns the number of bits written in total. Further writes
+  // continue after the last bit written.
+  size_t Flush() {
+    if (pending_bits_ > 0)
+      bytes_[byte_offset_] = static_cast<uint8_t>(pending_ >> 56);
+    return byte_offset_ * 8 + pending_bits_;
+  }
+
+ private:
+  // Moves the complete bytes of |pending_| to the buffer. WriteBits() checks
+  // that they fit.
+  void FlushWholeBytes() {
+    while (pending_bits_ >= 8) {
+      bytes_[byte_offset_++] = static_cast<uint8_t>(pending_ >> 56);
+      pending_ <<= 8;
+      pending_bits_ -= 8;
+    }
+  }
+
+  uint8_t* const bytes_;
+  const size_t byte_count_;
+  size_t byte_offset_ = 0;
+  // Pending bits, left aligned.
+  uint64_t pending_ = 0;
+  size_t pending_bits_ = 0;
+  bool ok_ = true;
+};
+
+}  // namespace rtc
+
+#endif  // RTC_BASE_CACHED_BIT_BUFFER_H_
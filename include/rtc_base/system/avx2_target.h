@@ -0,0 +1,33 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef RTC_BASE_SYSTEM_AVX2_TARGET_H_
+#define RTC_BASE_SYSTEM_AVX2_TARGET_H_
+
+#include "rtc_base/system/arch.h"
+
+// WEBRTC_AVX2_TARGET marks a function to be compiled for AVX2 regardless of
+// the flags of the including translation unit, so that inline AVX2 kernels can
+// live in headers and be called after runtime detection, see
+// DetectSimdOptimization(). WEBRTC_HAS_AVX2_TARGET is defined when the
+// compiler supports this.
+#if defined(WEBRTC_ARCH_X86_FAMILY) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define WEBRTC_AVX2_TARGET __attribute__((target("avx2")))
+#define WEBRTC_HAS_AVX2_TARGET
+#elif defined(WEBRTC_ARCH_X86_FAMILY) && defined(_MSC_VER)
+// MSVC accepts AVX2 intrinsics without /arch:AVX2.
+#define WEBRTC_AVX2_TARGET
+#define WEBRTC_HAS_AVX2_TARGET
+#else
+#define WEBRTC_AVX2_TARGET
+#endif
+
+#endif  // RTC_BASE_SYSTEM_AVX2_TARGET_H_
@@ -0,0 +1,48 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef SYSTEM_WRAPPERS_INCLUDE_SIMD_OPTIMIZATION_H_
+#define SYSTEM_WRAPPERS_INCLUDE_SIMD_OPTIMIZATION_H_
+
+#include "rtc_base/system/arch.h"
+#include "rtc_base/system/avx2_target.h"
+#include "system_wrappers/include/cpu_features_wrapper.h"
+
+namespace webrtc {
+
+// Kernel families for the inline SIMD helpers, e.g. in fec_xor.h, gf256.h,
+// h264_start_code_scanner.h and differ_block_simd.h. Each helper takes a
+// SimdOptimization and runs the widest kernel it has that is not wider; a
+// helper without a kernel for the given value falls back to a narrower one.
+enum class SimdOptimization { kNone, kSse2, kAvx2, kNeon };
+
+// Returns the widest kernel family supported by the CPU. The CPU is queried
+// on the first call only.
+inline SimdOptimization DetectSimdOptimization() {
+#if defined(WEBRTC_HAS_NEON)
+  return SimdOptimization::kNeon;
+#elif defined(WEBRTC_ARCH_X86_FAMILY)
+  static const SimdOptimization optimization = [] {
+#if defined(WEBRTC_HAS_AVX2_TARGET)
+    if (GetCPUInfo(kAVX2) != 0)
+      return SimdOptimization::kAvx2;
+#endif
+    return GetCPUInfo(kSSE2) != 0 ? SimdOptimization::kSse2
+                                  : SimdOptimization::kNone;
+  }();
+  return optimization;
+#else
+  return SimdOptimization::kNone;
+#endif
+}
+
+}  // namespace webrtc
+
+#endif  // SYSTEM_WRAPPERS_INCLUDE_SIMD_OPTIMIZATION_H_
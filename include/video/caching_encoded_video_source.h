@@ -0,0 +1,256 @@
+/*
+ *  Copyright (c) 2021 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef VIDEO_CACHING_ENCODED_VIDEO_SOURCE_H_
+#define VIDEO_CACHING_ENCODED_VIDEO_SOURCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "api/scoped_refptr.h"
+#include "api/sequence_checker.h"
+#include "api/units/data_size.h"
+#include "api/units/time_delta.h"
+#include "api/units/timestamp.h"
+#include "api/video/encoded_image.h"
+#include "api/video/encoded_video_source.h"
+#include "modules/video_coding/include/video_codec_interface.h"
+#include "rtc_base/checks.h"
+#include "rtc_base/ref_counted_object.h"
+#include "rtc_base/system/no_unique_address.h"
+#include "rtc_base/thread_annotations.h"
+#include "system_wrappers/include/clock.h"
+
+namespace webrtc {
+
+// EncodedVideoSourceInterface for forwarding one encoded stream to many
+// senders, which serves new receivers from a cache of the current key frame
+// and the delta frames that followed it, instead of asking the original
+// encoder for a new key frame that every other receiver would pay for too.
+//
+// The upstream stream is fed through OnEncodedFrame(). Each key frame clears
+// the cache and starts a new group of frames. When a sink that has not been
+// sent the current group yet, i.e. one added since, asks for a key frame, the
+// cached group is replayed to that sink only, and the sink continues with the
+// live frames. The frames share their EncodedImageBuffers, so replaying
+// copies no payload.
+//
+// A sink that has already been sent the current group, and so lost frames on
+// its own transport, gets a real key frame. Such requests are coalesced:
+// while a request forwarded upstream is pending, i.e. until the next key
+// frame arrives, further requests are absorbed, since that key frame serves
+// them all. Requests arriving after it was delivered are forwarded again. A
+// pending request older than |Config::key_frame_request_interval| is assumed
+// lost and no longer absorbs requests.
+//
+// The cache is dropped, and requests go upstream, while it exceeds
+// |Config::max_frames| or |Config::max_size|. Replaying a long group would
+// send a burst through the new sink's pacer and delay its first frame more
+// than waiting for a key frame.
+//
+// All methods must be called on the same sequence, the worker thread.
+// Sinks may call AddSink(), RemoveSink() and OnKeyFrameRequested() from their
+// OnEncodedFrame(); OnEncodedFrame() itself must not be re-entered.
+class CachingEncodedVideoSource : public EncodedVideoSourceInterface,
+                                  public EncodedVideoSinkInterface {
+ public:
+  struct Config {
+    size_t max_frames = 120;
+    DataSize max_size = DataSize::Bytes(4 * 1024 * 1024);
+    TimeDelta key_frame_request_interval = TimeDelta::Millis(300);
+  };
+
+  struct Stats {
+    // Key frame requests received from sinks, served from the cache,
+    // absorbed by coalescing, and forwarded upstream.
+    size_t key_frame_requests = 0;
+    size_t served_from_cache = 0;
+    size_t coalesced = 0;
+    size_t forwarded = 0;
+  };
+
+  // |request_key_frame| asks the original encoder for a key frame, e.g. by
+  // sending a PLI on the receive stream the frames come from.
+  static rtc::scoped_refptr<CachingEncodedVideoSource> Create(
+      Clock* clock,
+      const Config& config,
+      std::function<void()> request_key_frame) {
+    return new rtc::RefCountedObject<CachingEncodedVideoSource>(
+        clock, config, std::move(request_key_frame));
+  }
+
+  // Implements EncodedVideoSourceInterface.
+  void AddSink(EncodedVideoSinkInterface* sink) override {
+    RTC_DCHECK_RUN_ON(&sequence_checker_);
+    sinks_.emplace(sink, SinkState());
+  }
+
+  void RemoveSink(EncodedVideoSinkInterface* sink) override {
+    RTC_DCHECK_RUN_ON(&sequence_checker_);
+    sinks_.erase(sink);
+  }
+
+  void OnKeyFrameRequested(EncodedVideoSinkInterface* sink) override {
+    RTC_DCHECK_RUN_ON(&sequence_checker_);
+    ++stats_.key_frame_requests;
+    auto it = sinks_.find(sink);
+    if (it == sinks_.end())
+      return;
+    if (it->second.synced_group_id != group_id_ && !cache_.empty()) {
+      ++stats_.served_from_cache;
+      // Marked before the replay; |it| may be invalidated by the sink adding
+      // or removing sinks from its callback.
+      it->second.synced_group_id = group_id_;
+      ReplayCache(sink);
+      return;
+    }
+    MaybeRequestKeyFrame();
+  }
+
+  // Implements EncodedVideoSinkInterface. Upstream frames, delivered to all
+  // sinks that have a decodable starting point, and cached.
+  void OnEncodedFrame(const EncodedImage& encoded_image,
+                      const CodecSpecificInfo* codec_specific_info) override {
+    RTC_DCHECK_RUN_ON(&sequence_checker_);
+    const bool key_frame =
+        encoded_image._frameType == VideoFrameType::kVideoFrameKey;
+    if (key_frame) {
+      ++group_id_;
+      cache_.clear();
+      cache_size_ = DataSize::Zero();
+      cache_overflowed_ = false;
+      last_forwarded_request_ = absl::nullopt;
+    }
+
+    // Sinks may add or remove sinks from their callback, so deliver to a
+    // snapshot, skipping sinks removed by an earlier callback. Sinks added
+    // meanwhile have no starting point yet and are not delivered to.
+    std::vector<EncodedVideoSinkInterface*> synced_sinks;
+    synced_sinks.reserve(sinks_.size());
+    for (auto& sink_and_state : sinks_) {
+      SinkState& state = sink_and_state.second;
+      if (key_frame)
+        state.synced_group_id = group_id_;
+      if (state.synced_group_id == group_id_)
+        synced_sinks.push_back(sink_and_state.first);
+    }
+    RTC_DCHECK(!delivering_) << "OnEncodedFrame called from a sink callback";
+    delivering_ = true;
+    for (EncodedVideoSinkInterface* sink : synced_sinks) {
+      if (sinks_.count(sink) > 0)
+        sink->OnEncodedFrame(encoded_image, codec_specific_info);
+    }
+    delivering_ = false;
+
+    // Delta frames before the first key frame, or after an overflow, cannot
+    // be replayed usefully.
+    if (cache_overflowed_ || (cache_.empty() && !key_frame))
+      return;
+    cache_size_ += DataSize::Bytes(encoded_image.size());
+    if (cache_.size() + 1 > config_.max_frames ||
+        cache_size_ > config_.max_size) {
+      cache_.clear();
+      cache_size_ = DataSize::Zero();
+      cache_overflowed_ = true;
+      return;
+    }
+    CachedFrame frame;
+    frame.encoded_image = encoded_image;
+    if (codec_specific_info)
+      frame.codec_specific_info = *codec_specific_info;
+    cache_.push_back(std::move(frame));
+  }
+
+  Stats GetStats() const {
+    RTC_DCHECK_RUN_ON(&sequence_checker_);
+    return stats_;
+  }
+
+ protected:
+  CachingEncodedVideoSource(Clock* clock,
+                            const Config& config,
+                            std::function<void()> request_key_frame)
+      : clock_(clock),
+        config_(config),
+        request_key_frame_(std::move(request_key_frame)) {}
+  ~CachingEncodedVideoSource() override = default;
+
+ private:
+  struct CachedFrame {
+    EncodedImage encoded_image;
+    absl::optional<CodecSpecificInfo> codec_specific_info;
+  };
+  struct SinkState {
+    // Id of the last group of frames, see |group_id_|, that the sink has been
+    // sent from its key frame on; nullopt if none yet, in which case live
+    // delta frames are withheld from it until it has a key frame.
+    absl::optional<int64_t> synced_group_id;
+  };
+
+  void ReplayCache(EncodedVideoSinkInterface* sink)
+      RTC_RUN_ON(sequence_checker_) {
+    // Indexed, and stops if the sink removes itself, since the callbacks may
+    // call back into this class.
+    for (size_t i = 0; i < cache_.size() && sinks_.count(sink) > 0; ++i) {
+      const CachedFrame& frame = cache_[i];
+      sink->OnEncodedFrame(frame.encoded_image,
+                           frame.codec_specific_info
+                               ? &*frame.codec_specific_info
+                               : nullptr);
+    }
+  }
+
+  // Forwards a key frame request upstream unless a forwarded one is still
+  // pending, i.e. no key frame has arrived since, and was forwarded less than
+  // |config_.key_frame_request_interval| ago.
+  void MaybeRequestKeyFrame() RTC_RUN_ON(sequence_checker_) {
+    const Timestamp now = clock_->CurrentTime();
+    if (last_forwarded_request_ &&
+        now - *last_forwarded_request_ < config_.key_frame_request_interval) {
+      ++stats_.coalesced;
+      return;
+    }
+    ++stats_.forwarded;
+    last_forwarded_request_ = now;
+    request_key_frame_();
+  }
+
+  RTC_NO_UNIQUE_ADDRESS SequenceChecker sequence_checker_;
+  Clock* const clock_;
+  const Config config_;
+  const std::function<void()> request_key_frame_;
+
+  std::map<EncodedVideoSinkInterface*, SinkState> sinks_
+      RTC_GUARDED_BY(sequence_checker_);
+  // The current key frame followed by the delta frames since; empty until the
+  // first key frame and after the cache has overflowed.
+  std::vector<CachedFrame> cache_ RTC_GUARDED_BY(sequence_checker_);
+  DataSize cache_size_ RTC_GUARDED_BY(sequence_checker_) = DataSize::Zero();
+  bool cache_overflowed_ RTC_GUARDED_BY(sequence_checker_) = false;
+  // Set while OnEncodedFrame() delivers to the sinks.
+  bool delivering_ RTC_GUARDED_BY(sequence_checker_) = false;
+  // Incremented for each key frame.
+  int64_t group_id_ RTC_GUARDED_BY(sequence_checker_) = 0;
+  // Time of the request forwarded upstream that no key frame has answered
+  // yet, if any.
+  absl::optional<Timestamp> last_forwarded_request_
+      RTC_GUARDED_BY(sequence_checker_);
+  Stats stats_ RTC_GUARDED_BY(sequence_checker_);
+};
+
+}  // namespace webrtc
+
+#endif  // VIDEO_CACHING_ENCODED_VIDEO_SOURCE_H_